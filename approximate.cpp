@@ -0,0 +1,468 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include "approximate.h"
+
+// APPROXIMATEMATCHER CLASS //////////////////////////////////////////////////////
+
+ApproximateMatcher::ApproximateMatcher(): classOf(256, 0), classes(1), states(0), firstArrow(1, 0), firstAny(1, 0),
+    start(-1), errors(0), parallel(false), words(0), positions(0) {
+}
+ApproximateMatcher::ApproximateMatcher(const NFA& nfa, int errors) {
+    this->compile(nfa, errors);
+}
+ApproximateMatcher::ApproximateMatcher(const ENFA& enfa, int errors) {
+    this->compile(enfa, errors);
+}
+// an NFA has no epsilon arrows, so it is used as it is
+void ApproximateMatcher::compile(const NFA& nfa, int errors) {
+    this->build(nfa, errors);
+}
+// an ENFA is turned into an NFA of the same language first
+void ApproximateMatcher::compile(const ENFA& enfa, int errors) {
+    NFA nfa;
+    enfa.removeEpsilons(nfa);
+    this->build(nfa, errors);
+}
+// number the states, split the bytes into classes that every arrow treats the same, lay out
+// the targets per state and class and per state on any symbol, and build the tables of the
+// bit parallel simulation when its positions fit in a few words
+void ApproximateMatcher::build(const NFA& nfa, int errors) {
+    this->errors = errors < 0 ? 0 : errors;
+    std::vector<std::string> names = nfa.getStates();
+    std::map<std::string, int> index;
+    for (size_t i = 0; i < names.size(); i++) {
+        index.insert(std::make_pair(names[i], i));
+    }
+    this->states = names.size();
+    // every arrow as (state, target) with its label as a byte range
+    std::vector<std::pair<int, int> > labelled;
+    std::vector<SymbolRange> labels;
+    std::multimap<std::pair<std::string, char>, std::string> transitions = nfa.getTransitionFunction();
+    std::multimap<std::pair<std::string, char>, std::string>::iterator it;
+    for (it = transitions.begin(); it != transitions.end(); it++) {
+        std::map<std::string, int>::iterator from = index.find(it->first.first);
+        std::map<std::string, int>::iterator to = index.find(it->second);
+        if (from != index.end() and to != index.end()) {
+            labelled.push_back(std::make_pair(from->second, to->second));
+            labels.push_back(SymbolRange(it->first.second, it->first.second));
+        }
+    }
+    std::multimap<std::pair<std::string, SymbolRange>, std::string> ranges = nfa.getRangeTransitionFunction();
+    std::multimap<std::pair<std::string, SymbolRange>, std::string>::iterator range;
+    for (range = ranges.begin(); range != ranges.end(); range++) {
+        std::map<std::string, int>::iterator from = index.find(range->first.first);
+        std::map<std::string, int>::iterator to = index.find(range->second);
+        if (from != index.end() and to != index.end()) {
+            labelled.push_back(std::make_pair(from->second, to->second));
+            labels.push_back(range->first.second);
+        }
+    }
+    // bytes that are on exactly the same arrows share a class, bytes on none get class 0
+    std::vector<std::vector<int> > arrowsof(256);
+    for (size_t i = 0; i < labels.size(); i++) {
+        int last = static_cast<unsigned char>(labels[i].second);
+        for (int byte = static_cast<unsigned char>(labels[i].first); byte <= last; byte++) {
+            arrowsof[byte].push_back(i);
+        }
+    }
+    std::map<std::vector<int>, int> classids;
+    classids.insert(std::make_pair(std::vector<int>(), 0));
+    this->classOf.assign(256, 0);
+    for (int byte = 0; byte < 256; byte++) {
+        std::map<std::vector<int>, int>::iterator found = classids.find(arrowsof[byte]);
+        if (found == classids.end()) {
+            found = classids.insert(std::make_pair(arrowsof[byte], classids.size())).first;
+        }
+        this->classOf[byte] = found->second;
+    }
+    this->classes = classids.size();
+    // (state * classes + class, target) for every arrow and class it is on, sorted into rows,
+    // (state, target) for every arrow whatever its label, and the classes of every arrow
+    std::vector<std::pair<size_t, int> > slots;
+    std::vector<std::pair<int, int> > anyslots(labelled);
+    std::vector<std::vector<int> > classesof(labels.size());
+    std::vector<bool> seen(this->classes);
+    for (size_t i = 0; i < labels.size(); i++) {
+        seen.assign(this->classes, false);
+        int last = static_cast<unsigned char>(labels[i].second);
+        for (int byte = static_cast<unsigned char>(labels[i].first); byte <= last; byte++) {
+            int c = this->classOf[byte];
+            if (!seen[c]) {
+                seen[c] = true;
+                slots.push_back(std::make_pair(labelled[i].first * this->classes + c, labelled[i].second));
+                classesof[i].push_back(c);
+            }
+        }
+        std::sort(classesof[i].begin(), classesof[i].end());
+    }
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+    this->firstArrow.assign(this->states * this->classes + 1, 0);
+    this->arrows.clear();
+    std::vector<std::pair<size_t, int> >::iterator slot = slots.begin();
+    for (size_t row = 0; row < this->states * this->classes; row++) {
+        while (slot != slots.end() and slot->first == row) {
+            this->arrows.push_back(slot->second);
+            slot++;
+        }
+        this->firstArrow[row + 1] = this->arrows.size();
+    }
+    std::sort(anyslots.begin(), anyslots.end());
+    anyslots.erase(std::unique(anyslots.begin(), anyslots.end()), anyslots.end());
+    this->firstAny.assign(this->states + 1, 0);
+    this->anyArrows.clear();
+    std::vector<std::pair<int, int> >::iterator arrow = anyslots.begin();
+    for (size_t state = 0; state < this->states; state++) {
+        while (arrow != anyslots.end() and arrow->first == static_cast<int>(state)) {
+            this->anyArrows.push_back(arrow->second);
+            arrow++;
+        }
+        this->firstAny[state + 1] = this->anyArrows.size();
+    }
+    this->accepting.assign(this->states, false);
+    std::vector<std::string> accepts = nfa.getAcceptStates();
+    std::vector<std::string>::iterator name;
+    for (name = accepts.begin(); name != accepts.end(); name++) {
+        std::map<std::string, int>::iterator found = index.find(*name);
+        if (found != index.end()) {
+            this->accepting[found->second] = true;
+        }
+    }
+    std::map<std::string, int>::iterator found = index.find(nfa.getStartState());
+    this->start = found == index.end() ? -1 : found->second;
+    this->lazyIds.clear();
+    this->lazyKeys.clear();
+    this->lazyTable.clear();
+    this->lazyDistance.clear();
+    this->follow.clear();
+    this->classMasks.clear();
+    // position 0 is the start state, every other position a target with the classes of the
+    // arrows into it
+    std::map<std::pair<int, std::vector<int> >, int> positionids;
+    std::vector<int> arrowposition(labels.size());
+    std::vector<std::vector<int> > positionsof(this->states);
+    std::vector<int> stateof(1, this->start);
+    if (this->start >= 0) {
+        positionsof[this->start].push_back(0);
+    }
+    for (size_t i = 0; i < labels.size(); i++) {
+        std::pair<int, std::vector<int> > position(labelled[i].second, classesof[i]);
+        std::map<std::pair<int, std::vector<int> >, int>::iterator found = positionids.find(position);
+        if (found == positionids.end()) {
+            found = positionids.insert(std::make_pair(position, stateof.size())).first;
+            positionsof[labelled[i].second].push_back(stateof.size());
+            stateof.push_back(labelled[i].second);
+        }
+        arrowposition[i] = found->second;
+    }
+    this->parallel = this->start >= 0 and stateof.size() <= maxparallelwords * 64;
+    if (!this->parallel) {
+        // the lazy DFA works on sets of states
+        this->positions = 0;
+        this->words = (this->states + 63) / 64;
+        this->startMask.assign(this->words, 0);
+        this->acceptMask.assign(this->words, 0);
+        if (this->start >= 0) {
+            this->startMask[this->start / 64] |= uint64_t(1) << (this->start % 64);
+        }
+        for (size_t state = 0; state < this->states; state++) {
+            if (this->accepting[state]) {
+                this->acceptMask[state / 64] |= uint64_t(1) << (state % 64);
+            }
+        }
+        return;
+    }
+    this->positions = stateof.size();
+    this->words = (this->positions + 63) / 64;
+    this->startMask.assign(this->words, 0);
+    this->startMask[0] = 1;
+    this->acceptMask.assign(this->words, 0);
+    this->classMasks.assign(this->classes * this->words, 0);
+    for (size_t position = 0; position < this->positions; position++) {
+        if (this->accepting[stateof[position]]) {
+            this->acceptMask[position / 64] |= uint64_t(1) << (position % 64);
+        }
+    }
+    // an arrow puts its position in the follow set of every position of its state, and in
+    // the mask of each of its classes
+    std::vector<uint64_t> single(this->positions * this->words, 0);
+    for (size_t i = 0; i < labels.size(); i++) {
+        size_t target = arrowposition[i];
+        std::vector<int>::iterator position;
+        for (position = positionsof[labelled[i].first].begin(); position != positionsof[labelled[i].first].end(); position++) {
+            single[*position * this->words + target / 64] |= uint64_t(1) << (target % 64);
+        }
+        std::vector<int>::iterator c;
+        for (c = classesof[i].begin(); c != classesof[i].end(); c++) {
+            this->classMasks[*c * this->words + target / 64] |= uint64_t(1) << (target % 64);
+        }
+    }
+    // the follow mask of a byte value is the union of its bits, built from the value with its
+    // lowest bit cleared
+    size_t bytes = (this->positions + 7) / 8;
+    this->follow.assign(bytes * 256 * this->words, 0);
+    for (size_t byte = 0; byte < bytes; byte++) {
+        uint64_t* table = &this->follow[byte * 256 * this->words];
+        for (unsigned int value = 1; value < 256; value++) {
+            unsigned int bit = 0;
+            while (!(value & (1u << bit))) {
+                bit++;
+            }
+            size_t position = byte * 8 + bit;
+            for (size_t w = 0; w < this->words; w++) {
+                table[value * this->words + w] = table[(value & (value - 1)) * this->words + w];
+                if (position < this->positions) {
+                    table[value * this->words + w] |= single[position * this->words + w];
+                }
+            }
+        }
+    }
+}
+// the successors of a copy on a byte of the given class and on any symbol
+void ApproximateMatcher::advance(const uint64_t* current, size_t c, uint64_t* next, uint64_t* anynext) const {
+    std::fill(next, next + this->words, 0);
+    std::fill(anynext, anynext + this->words, 0);
+    if (this->parallel) {
+        for (size_t w = 0; w < this->words; w++) {
+            uint64_t bits = current[w];
+            for (size_t b = 0; bits != 0; b++, bits >>= 8) {
+                unsigned int value = bits & 0xff;
+                if (value == 0) {
+                    continue;
+                }
+                const uint64_t* mask = &this->follow[((w * 8 + b) * 256 + value) * this->words];
+                for (size_t i = 0; i < this->words; i++) {
+                    anynext[i] |= mask[i];
+                }
+            }
+        }
+        const uint64_t* mask = &this->classMasks[c * this->words];
+        for (size_t i = 0; i < this->words; i++) {
+            next[i] = anynext[i] & mask[i];
+        }
+        return;
+    }
+    for (size_t w = 0; w < this->words; w++) {
+        uint64_t bits = current[w];
+        for (size_t state = w * 64; bits != 0; state++, bits >>= 1) {
+            if (!(bits & 1)) {
+                continue;
+            }
+            size_t row = state * this->classes + c;
+            for (size_t a = this->firstArrow[row]; a < this->firstArrow[row + 1]; a++) {
+                next[this->arrows[a] / 64] |= uint64_t(1) << (this->arrows[a] % 64);
+            }
+            for (size_t a = this->firstAny[state]; a < this->firstAny[state + 1]; a++) {
+                anynext[this->anyArrows[a] / 64] |= uint64_t(1) << (this->anyArrows[a] % 64);
+            }
+        }
+    }
+}
+// add a copy and its successors on any symbol to another
+void ApproximateMatcher::addAny(const uint64_t* current, uint64_t* next) const {
+    for (size_t w = 0; w < this->words; w++) {
+        next[w] |= current[w];
+    }
+    if (this->parallel) {
+        for (size_t w = 0; w < this->words; w++) {
+            uint64_t bits = current[w];
+            for (size_t b = 0; bits != 0; b++, bits >>= 8) {
+                unsigned int value = bits & 0xff;
+                if (value == 0) {
+                    continue;
+                }
+                const uint64_t* mask = &this->follow[((w * 8 + b) * 256 + value) * this->words];
+                for (size_t i = 0; i < this->words; i++) {
+                    next[i] |= mask[i];
+                }
+            }
+        }
+        return;
+    }
+    for (size_t w = 0; w < this->words; w++) {
+        uint64_t bits = current[w];
+        for (size_t state = w * 64; bits != 0; state++, bits >>= 1) {
+            if (!(bits & 1)) {
+                continue;
+            }
+            for (size_t a = this->firstAny[state]; a < this->firstAny[state + 1]; a++) {
+                next[this->anyArrows[a] / 64] |= uint64_t(1) << (this->anyArrows[a] % 64);
+            }
+        }
+    }
+}
+// copy 0 holds the start state, every next copy adds what one more deleted symbol reaches
+void ApproximateMatcher::firstLayers(std::vector<uint64_t>& layers) const {
+    layers.assign((this->errors + 1) * this->words, 0);
+    std::copy(this->startMask.begin(), this->startMask.end(), layers.begin());
+    for (int i = 1; i <= this->errors; i++) {
+        this->addAny(&layers[(i - 1) * this->words], &layers[i * this->words]);
+    }
+}
+// copy i after the byte: copy i along the byte, copy i - 1 before the byte as it is (the byte
+// is inserted) and along any symbol (the byte replaces it), and copy i - 1 after the byte as
+// it is and along any symbol (a symbol is deleted)
+void ApproximateMatcher::stepLayers(std::vector<uint64_t>& layers, size_t c, bool restart,
+                                    std::vector<uint64_t>& next, std::vector<uint64_t>& anynext) const {
+    size_t words = this->words;
+    for (int i = 0; i <= this->errors; i++) {
+        this->advance(&layers[i * words], c, &next[i * words], &anynext[i * words]);
+    }
+    for (int i = this->errors; i > 0; i--) {
+        for (size_t w = 0; w < words; w++) {
+            layers[i * words + w] = next[i * words + w] | layers[(i - 1) * words + w] | anynext[(i - 1) * words + w];
+        }
+    }
+    for (size_t w = 0; w < words; w++) {
+        layers[w] = next[w];
+        if (restart) {
+            layers[w] |= this->startMask[w];
+        }
+    }
+    for (int i = 1; i <= this->errors; i++) {
+        this->addAny(&layers[(i - 1) * words], &layers[i * words]);
+    }
+}
+// the first copy that holds an accept state
+int ApproximateMatcher::layerDistance(const std::vector<uint64_t>& layers) const {
+    for (int i = 0; i <= this->errors; i++) {
+        for (size_t w = 0; w < this->words; w++) {
+            if (layers[i * this->words + w] & this->acceptMask[w]) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+// the lazy DFA state for the copies, added with unknown successors when it is new
+int ApproximateMatcher::lazyState(const std::vector<uint64_t>& layers, bool restart) {
+    std::vector<uint64_t> key(layers);
+    key.push_back(restart ? 1 : 0);
+    std::map<std::vector<uint64_t>, int>::iterator found = this->lazyIds.find(key);
+    if (found != this->lazyIds.end()) {
+        return found->second;
+    }
+    int id = this->lazyKeys.size();
+    this->lazyIds.insert(std::make_pair(key, id));
+    this->lazyKeys.push_back(key);
+    this->lazyDistance.push_back(this->layerDistance(layers));
+    this->lazyTable.resize(this->lazyTable.size() + this->classes, -1);
+    return id;
+}
+// the successor of a lazy DFA state on a byte of the given class, computed the first time
+// it is asked for. when the cache is full it is emptied and starts over from the successor
+int ApproximateMatcher::lazyNext(int id, size_t c) {
+    int known = this->lazyTable[id * this->classes + c];
+    if (known >= 0) {
+        return known;
+    }
+    std::vector<uint64_t> layers(this->lazyKeys[id].begin(), this->lazyKeys[id].end() - 1);
+    bool restart = this->lazyKeys[id].back() != 0;
+    std::vector<uint64_t> next(layers.size());
+    std::vector<uint64_t> anynext(layers.size());
+    this->stepLayers(layers, c, restart, next, anynext);
+    if (this->lazyKeys.size() >= maxlazystates) {
+        this->lazyIds.clear();
+        this->lazyKeys.clear();
+        this->lazyTable.clear();
+        this->lazyDistance.clear();
+        return this->lazyState(layers, restart);
+    }
+    int successor = this->lazyState(layers, restart);
+    this->lazyTable[id * this->classes + c] = successor;
+    return successor;
+}
+// run the copies over the whole text
+int ApproximateMatcher::distance(const char* text, size_t length) {
+    if (this->start < 0) {
+        return -1;
+    }
+    std::vector<uint64_t> layers;
+    this->firstLayers(layers);
+    if (this->parallel) {
+        std::vector<uint64_t> next(layers.size());
+        std::vector<uint64_t> anynext(layers.size());
+        const uint64_t* last = &layers[this->errors * this->words];
+        for (size_t i = 0; i < length; i++) {
+            this->stepLayers(layers, this->classOf[static_cast<unsigned char>(text[i])], false, next, anynext);
+            // copy k holds every other copy, once it is empty nothing can be accepted
+            bool active = false;
+            for (size_t w = 0; w < this->words; w++) {
+                active = active or last[w] != 0;
+            }
+            if (!active) {
+                return -1;
+            }
+        }
+        return this->layerDistance(layers);
+    }
+    int state = this->lazyState(layers, false);
+    for (size_t i = 0; i < length; i++) {
+        state = this->lazyNext(state, this->classOf[static_cast<unsigned char>(text[i])]);
+    }
+    return this->lazyDistance[state];
+}
+int ApproximateMatcher::distance(const std::string& text) {
+    return this->distance(text.data(), text.size());
+}
+bool ApproximateMatcher::accepts(const std::string& text) {
+    return this->distance(text.data(), text.size()) >= 0;
+}
+// run the copies over the text with the start state added to copy 0 after every byte, so
+// copy i holds the states some substring ending here reaches with at most i edits
+void ApproximateMatcher::search(const char* text, size_t length, std::vector<ApproximateMatch>& matches) {
+    if (this->start < 0) {
+        return;
+    }
+    std::vector<uint64_t> layers;
+    this->firstLayers(layers);
+    if (this->parallel) {
+        std::vector<uint64_t> next(layers.size());
+        std::vector<uint64_t> anynext(layers.size());
+        int found = this->layerDistance(layers);
+        if (found >= 0) {
+            matches.push_back(ApproximateMatch(0, found));
+        }
+        for (size_t i = 0; i < length; i++) {
+            this->stepLayers(layers, this->classOf[static_cast<unsigned char>(text[i])], true, next, anynext);
+            found = this->layerDistance(layers);
+            if (found >= 0) {
+                matches.push_back(ApproximateMatch(i + 1, found));
+            }
+        }
+        return;
+    }
+    int state = this->lazyState(layers, true);
+    if (this->lazyDistance[state] >= 0) {
+        matches.push_back(ApproximateMatch(0, this->lazyDistance[state]));
+    }
+    for (size_t i = 0; i < length; i++) {
+        state = this->lazyNext(state, this->classOf[static_cast<unsigned char>(text[i])]);
+        if (this->lazyDistance[state] >= 0) {
+            matches.push_back(ApproximateMatch(i + 1, this->lazyDistance[state]));
+        }
+    }
+}
+std::vector<ApproximateMatch> ApproximateMatcher::search(const std::string& text) {
+    std::vector<ApproximateMatch> matches;
+    this->search(text.data(), text.size(), matches);
+    return matches;
+}
+// whether the automaton is simulated bit parallel
+bool ApproximateMatcher::isBitParallel() const {
+    return this->parallel;
+}
+// number of states of the automaton without epsilon arrows
+size_t ApproximateMatcher::size() const {
+    return this->states;
+}
+// number of positions of the bit parallel simulation, 0 when determinized lazily
+size_t ApproximateMatcher::getPositionCount() const {
+    return this->positions;
+}
+// number of states the lazy DFA has built so far
+size_t ApproximateMatcher::getLazyStateCount() const {
+    return this->lazyKeys.size();
+}
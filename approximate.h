@@ -0,0 +1,112 @@
+/* Approximate matching against the language of an automaton.
+ * ApproximateMatcher accepts the strings within a given number of edits (substituted,
+ * inserted or deleted bytes) of some string of the language of an NFA or ENFA. It runs the
+ * k-error automaton of Wu and Manber: k + 1 copies of the automaton, where copy i holds the
+ * states reachable with at most i edits. Reading a byte moves every copy along its arrows
+ * for that byte and also moves copy i - 1 into copy i in three ways: staying put (the byte
+ * is inserted), along any arrow (the byte substitutes the symbol of the arrow), and along
+ * any arrow without reading (a symbol is deleted). An ENFA has its epsilon arrows removed
+ * first; the distance to a language does not depend on the automaton that describes it.
+ * Small automata are simulated bit parallel, like GlushkovMatcher: every (target, label) of
+ * an arrow becomes a position, so all arrows into a position carry the same label, the
+ * successors of a copy on any symbol are the union of the follow sets of its positions
+ * (looked up per byte of the copy) and its successors on a byte are those masked with the
+ * positions of the byte. Automata with more positions than fit in a few words are
+ * determinized lazily: the copies together are a DFA state, whose successor on a symbol
+ * class is computed the first time it is needed and remembered, with the cache emptied
+ * when it grows too large. Either way a text is read once, with a bounded amount of work
+ * per byte.
+**/
+#ifndef APPROXIMATE_H_
+#define APPROXIMATE_H_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cstddef>
+#include <stdint.h>
+#include "automata.h"
+
+// the most words of positions a copy may take to be simulated bit parallel
+static const size_t maxparallelwords = 4;
+// the lazy DFA is emptied once it has this many states
+static const size_t maxlazystates = 4096;
+
+// the end offset of a match and the fewest edits a match ending there needs
+typedef std::pair<size_t, int> ApproximateMatch;
+
+class ApproximateMatcher {
+    private:
+        std::vector<int> classOf;
+        size_t classes;
+        size_t states;
+        // the targets of state s on class c are arrows[firstArrow[s * classes + c]] up to
+        // arrows[firstArrow[s * classes + c + 1]], and its targets on any symbol are
+        // anyArrows[firstAny[s]] up to anyArrows[firstAny[s + 1]]
+        std::vector<size_t> firstArrow;
+        std::vector<int> arrows;
+        std::vector<size_t> firstAny;
+        std::vector<int> anyArrows;
+        std::vector<bool> accepting;
+        int start;
+        int errors;
+        bool parallel;
+        // words per copy: of positions when bit parallel, of states otherwise
+        size_t words;
+        // bit parallel: the follow masks per byte of a copy and its value, ((word * 8 +
+        // byte) * 256 + value) * words, and the positions per class, class * words
+        size_t positions;
+        std::vector<uint64_t> follow;
+        std::vector<uint64_t> classMasks;
+        // the positions or states a run starts in and accepts in
+        std::vector<uint64_t> startMask;
+        std::vector<uint64_t> acceptMask;
+        // lazy DFA: the copies of a state followed by whether the start state is added after
+        // every byte, its successors per class (-1 while unknown) and the fewest edits it
+        // accepts with (-1 for none)
+        std::map<std::vector<uint64_t>, int> lazyIds;
+        std::vector<std::vector<uint64_t> > lazyKeys;
+        std::vector<int> lazyTable;
+        std::vector<int> lazyDistance;
+        // number the states of an NFA without epsilon arrows and build the tables
+        void build(const NFA&, int);
+        // the successors of a copy on a byte of the given class and on any symbol
+        void advance(const uint64_t*, size_t, uint64_t*, uint64_t*) const;
+        // add a copy and its successors on any symbol to another
+        void addAny(const uint64_t*, uint64_t*) const;
+        // the copies before the first byte, and after a byte of the given class with two
+        // scratch vectors of their size. with restart a match may start after every byte
+        void firstLayers(std::vector<uint64_t>&) const;
+        void stepLayers(std::vector<uint64_t>&, size_t, bool, std::vector<uint64_t>&, std::vector<uint64_t>&) const;
+        // the first copy that accepts, -1 for none
+        int layerDistance(const std::vector<uint64_t>&) const;
+        int lazyState(const std::vector<uint64_t>&, bool);
+        int lazyNext(int, size_t);
+    public:
+        ApproximateMatcher();
+        ApproximateMatcher(const NFA&, int);
+        ApproximateMatcher(const ENFA&, int);
+        // match within the given number of edits of the language of an automaton
+        void compile(const NFA&, int);
+        void compile(const ENFA&, int);
+        // the fewest edits that turn the text into a string of the language, -1 when that
+        // takes more than the allowed number
+        int distance(const char*, size_t);
+        int distance(const std::string&);
+        // whether the text is within the allowed edits of the language
+        bool accepts(const std::string&);
+        // append every offset where a substring of the text within the allowed edits of the
+        // language ends, with the fewest edits of those substrings
+        void search(const char*, size_t, std::vector<ApproximateMatch>&);
+        std::vector<ApproximateMatch> search(const std::string&);
+        // whether the automaton is simulated bit parallel
+        bool isBitParallel() const;
+        // number of states of the automaton without epsilon arrows
+        size_t size() const;
+        // number of positions of the bit parallel simulation, 0 when determinized lazily
+        size_t getPositionCount() const;
+        // number of states the lazy DFA has built so far
+        size_t getLazyStateCount() const;
+};
+
+#endif
@@ -4,10 +4,17 @@
 #include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <limits>
+#include <set>
+#include <map>
 #include "automata.h"
+#include "parallel.h"
 #include <sstream>
 #include <assert.h>
 
+// the smallest possible range key: char may be signed, so ranges of high bytes sort first
+static const SymbolRange lowestrange(std::numeric_limits<char>::min(), std::numeric_limits<char>::min());
+
 // HELPER FUNCTIONS //////////////////////////////////////////////////////////////
 
 // joins the second vector to the first, discarding duplicates
@@ -20,68 +27,311 @@ void mergeVector(std::vector<std::string>& vector1, const std::vector<std::strin
     }
 }
 
+// returns whether the symbol lies within the range, comparing bytes as unsigned values
+bool inRange(char symbol, const SymbolRange& range) {
+    unsigned char value = symbol;
+    return value >= (unsigned char)range.first and value <= (unsigned char)range.second;
+}
+// split a set of symbols into maximal runs of consecutive bytes
+std::vector<SymbolRange> symbolRuns(std::vector<char> symbols) {
+    std::vector<unsigned char> bytes(symbols.begin(), symbols.end());
+    std::sort(bytes.begin(), bytes.end());
+    bytes.erase(std::unique(bytes.begin(), bytes.end()), bytes.end());
+    std::vector<SymbolRange> runs;
+    std::vector<unsigned char>::iterator it;
+    for (it = bytes.begin(); it != bytes.end(); it++) {
+        if (!runs.empty() and (unsigned char)runs.back().second + 1 == *it) {
+            runs.back().second = *it;
+        }
+        else {
+            runs.push_back(SymbolRange(*it, *it));
+        }
+    }
+    return runs;
+}
+// printable representation of a symbol: epsilon becomes \0 and bytes that
+// are not printable ascii are written as \xHH
+std::string symbolToString(char symbol) {
+    unsigned char value = symbol;
+    if (symbol == epsilon) {
+        return "\\0";
+    }
+    if (value < 0x20 or value > 0x7E) {
+        const char* digits = "0123456789ABCDEF";
+        std::string escaped = "\\x";
+        escaped += digits[value >> 4];
+        escaped += digits[value & 0xF];
+        return escaped;
+    }
+    return std::string(1, symbol);
+}
+// encode a code point in UTF-8, returning the number of bytes written
+static int encodeUtf8(unsigned long codepoint, unsigned char* bytes) {
+    if (codepoint <= 0x7F) {
+        bytes[0] = codepoint;
+        return 1;
+    }
+    if (codepoint <= 0x7FF) {
+        bytes[0] = 0xC0 | (codepoint >> 6);
+        bytes[1] = 0x80 | (codepoint & 0x3F);
+        return 2;
+    }
+    if (codepoint <= 0xFFFF) {
+        bytes[0] = 0xE0 | (codepoint >> 12);
+        bytes[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+        bytes[2] = 0x80 | (codepoint & 0x3F);
+        return 3;
+    }
+    bytes[0] = 0xF0 | (codepoint >> 18);
+    bytes[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+    bytes[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+    bytes[3] = 0x80 | (codepoint & 0x3F);
+    return 4;
+}
+static void splitUtf8(unsigned long lo, unsigned long hi, std::vector<std::vector<SymbolRange> >& sequences) {
+    if (lo > hi) {
+        return;
+    }
+    // surrogates have no UTF-8 encoding
+    if (lo < 0xD800 and hi > 0xDFFF) {
+        splitUtf8(lo, 0xD7FF, sequences);
+        splitUtf8(0xE000, hi, sequences);
+        return;
+    }
+    if (lo >= 0xD800 and hi <= 0xDFFF) {
+        return;
+    }
+    if (lo >= 0xD800 and lo <= 0xDFFF) {
+        lo = 0xE000;
+    }
+    if (hi >= 0xD800 and hi <= 0xDFFF) {
+        hi = 0xD7FF;
+    }
+    // both ends need the same encoded length
+    const unsigned long lengthlimits[] = {0x7F, 0x7FF, 0xFFFF};
+    for (int i = 0; i < 3; i++) {
+        if (lo <= lengthlimits[i] and hi > lengthlimits[i]) {
+            splitUtf8(lo, lengthlimits[i], sequences);
+            splitUtf8(lengthlimits[i] + 1, hi, sequences);
+            return;
+        }
+    }
+    // split until every continuation byte covers either one value or its full range
+    for (int i = 1; i < 4; i++) {
+        unsigned long mask = (1UL << (6 * i)) - 1;
+        if ((lo & ~mask) != (hi & ~mask)) {
+            if ((lo & mask) != 0) {
+                splitUtf8(lo, lo | mask, sequences);
+                splitUtf8((lo | mask) + 1, hi, sequences);
+                return;
+            }
+            if ((hi & mask) != mask) {
+                splitUtf8(lo, (hi & ~mask) - 1, sequences);
+                splitUtf8(hi & ~mask, hi, sequences);
+                return;
+            }
+        }
+    }
+    unsigned char lobytes[4];
+    unsigned char hibytes[4];
+    int length = encodeUtf8(lo, lobytes);
+    encodeUtf8(hi, hibytes);
+    std::vector<SymbolRange> sequence;
+    for (int i = 0; i < length; i++) {
+        sequence.push_back(SymbolRange(lobytes[i], hibytes[i]));
+    }
+    sequences.push_back(sequence);
+}
+// split a range of unicode code points into sequences of byte ranges matching its UTF-8
+// encoding, e.g. [U+0000-U+07FF] becomes [\x00-\x7F] and [\xC2-\xDF][\x80-\xBF]
+std::vector<std::vector<SymbolRange> > utf8Sequences(unsigned long lo, unsigned long hi) {
+    std::vector<std::vector<SymbolRange> > sequences;
+    if (hi > maxcodepoint) {
+        hi = maxcodepoint;
+    }
+    splitUtf8(lo, hi, sequences);
+    return sequences;
+}
+
 // AUTOMATON CLASS ///////////////////////////////////////////////////////////////
 
 // default constructor
-Automaton::Automaton() {
+Automaton::Automaton(): compacted(false) {
 }
-// overloading ostream<< for outputting in .dot format
-std::ostream& operator<<(std::ostream& os, const Automaton& fa) {
-    os << "digraph finite_state_automaton {" << std::endl;
-    os << "rankdir=LR;" << std::endl;
+// size of the buffer writeDot fills before handing it to the stream
+static const size_t dotbuffersize = 1 << 16;
+// quoted dot identifier for a state name
+static void appendDotId(std::string& buffer, const std::string& name) {
+    buffer += '"';
+    std::string::const_iterator it;
+    for (it = name.begin(); it != name.end(); it++) {
+        if (*it == '"' or *it == '\\') {
+            buffer += '\\';
+        }
+        buffer += *it;
+    }
+    buffer += '"';
+}
+// one symbol inside a dot label
+static void appendDotSymbol(std::string& buffer, unsigned char symbol) {
+    if (symbol == (unsigned char)epsilon) {
+        buffer += "&epsilon;";
+    }
+    else if (symbol == '"' or symbol == '\\') {
+        buffer += '\\';
+        buffer += symbol;
+    }
+    else {
+        std::string printable = symbolToString(symbol);
+        if (printable.length() > 1) {
+            // escape the backslash of \xHH for dot
+            buffer += '\\';
+        }
+        buffer += printable;
+    }
+}
+// write the arrows collected for one state, one line per target. labels are sorted and
+// runs of three or more consecutive symbols are written as a range (a-z)
+static void appendDotArrows(std::string& buffer, const std::string& state,
+                            std::vector<std::pair<std::string, unsigned char> >& arrows) {
+    std::sort(arrows.begin(), arrows.end());
+    size_t i = 0;
+    while (i < arrows.size()) {
+        size_t end = i;
+        while (end < arrows.size() and arrows[end].first == arrows[i].first) {
+            end++;
+        }
+        appendDotId(buffer, state);
+        buffer += " -> ";
+        appendDotId(buffer, arrows[i].first);
+        buffer += " [ label = \"";
+        size_t j = i;
+        while (j < end) {
+            size_t run = j;
+            while (run + 1 < end and arrows[run + 1].second == arrows[run].second + 1) {
+                run++;
+            }
+            if (j != i) {
+                buffer += ", ";
+            }
+            if (run - j >= 2) {
+                appendDotSymbol(buffer, arrows[j].second);
+                buffer += '-';
+                appendDotSymbol(buffer, arrows[run].second);
+            }
+            else {
+                for (size_t k = j; k <= run; k++) {
+                    if (k != j) {
+                        buffer += ", ";
+                    }
+                    appendDotSymbol(buffer, arrows[k].second);
+                }
+            }
+            j = run + 1;
+        }
+        buffer += "\" ];\n";
+        i = end;
+    }
+}
+// export to dot format. the transition multimaps are sorted on their origin state, so the
+// arrows of a state are found with one lookup instead of a delta call per symbol.
+// output is collected in a buffer that is only written when it is full.
+void writeDot(std::ostream& os, const Automaton& fa, size_t maxstates) {
+    typedef std::multimap<std::pair<std::string, char>, std::string>::const_iterator TransitionIt;
+    typedef std::multimap<std::pair<std::string, SymbolRange>, std::string>::const_iterator RangeIt;
+    std::string buffer;
+    buffer.reserve(dotbuffersize + 1024);
+    buffer += "digraph finite_state_automaton {\nrankdir=LR;\n";
 
-    std::stringstream ss;
-    std::vector<std::string>::const_iterator it = fa.acceptStates.begin();
-    while (true) {
-        ss << *it++;
-        if (it != fa.acceptStates.end()) {
-            ss << " ";
+    // choose the states to write: everything, or a breadth first sample from the start state
+    std::vector<std::string> states;
+    std::set<std::string> sample;
+    bool sampled = maxstates > 0 and maxstates < fa.states.size() and fa.hasState(fa.startState);
+    if (sampled) {
+        states.push_back(fa.startState);
+        sample.insert(fa.startState);
+        for (size_t i = 0; i < states.size() and states.size() < maxstates; i++) {
+            TransitionIt it = fa.transitionFunction.lower_bound(std::make_pair(states[i], std::numeric_limits<char>::min()));
+            for (; it != fa.transitionFunction.end() and it->first.first == states[i] and states.size() < maxstates; it++) {
+                if (sample.insert(it->second).second) {
+                    states.push_back(it->second);
+                }
+            }
+            RangeIt range = fa.rangeTransitionFunction.lower_bound(std::make_pair(states[i], lowestrange));
+            for (; range != fa.rangeTransitionFunction.end() and range->first.first == states[i] and states.size() < maxstates; range++) {
+                if (sample.insert(range->second).second) {
+                    states.push_back(range->second);
+                }
+            }
         }
-        else {
-            break;
+        std::stringstream ss;
+        ss << "// sample of " << states.size() << " out of " << fa.states.size() << " states\n";
+        buffer += ss.str();
+    }
+    else {
+        states = fa.states;
+    }
+
+    bool acceptfound = false;
+    std::vector<std::string>::const_iterator accept;
+    for (accept = fa.acceptStates.begin(); accept != fa.acceptStates.end(); accept++) {
+        if (sampled and sample.count(*accept) == 0) {
+            continue;
         }
+        buffer += acceptfound ? " " : "node [shape = doublecircle]; ";
+        appendDotId(buffer, *accept);
+        acceptfound = true;
+    }
+    if (acceptfound) {
+        buffer += '\n';
     }
-    os << "node [shape = doublecircle]; " << ss.str() << std::endl;
-    os << "node [shape = point]; emptystartnode" << std::endl;
-    os << "node [shape = circle];" << std::endl;
+    buffer += "node [shape = point]; emptystartnode\nnode [shape = circle];\n";
     // set up start arrow
-    os << "emptystartnode -> " << fa.getStartState() <<  " [ label = \"start\" ];" << std::endl;
-    // loop over states; generate all the arrows for each state
+    if (!fa.startState.empty()) {
+        buffer += "emptystartnode -> ";
+        appendDotId(buffer, fa.startState);
+        buffer += " [ label = \"start\" ];\n";
+    }
+    const std::string omitted = "...";
+    bool omittedused = false;
+    std::vector<std::pair<std::string, unsigned char> > arrows;
     std::vector<std::string>::const_iterator state;
-    for (state = fa.states.begin(); state != fa.states.end(); state++) {
-        std::map<std::string, std::vector<char> > arrows;
-        std::vector<char>::const_iterator symbol;
-        for (symbol = fa.symbols.begin(); symbol != fa.symbols.end(); symbol++) {
-            std::vector<std::string> delta = fa.delta(*state, *symbol);
-            std::vector<std::string>::iterator resultstate;
-            for (resultstate = delta.begin(); resultstate != delta.end(); resultstate++) {
-                std::map<std::string, std::vector<char> >::iterator arrow = arrows.find(*resultstate);
-                if (arrow == arrows.end()) {
-                    std::vector<char> arrowlabel;
-                    arrowlabel.push_back(*symbol);
-                    arrows.insert(std::make_pair(*resultstate, arrowlabel));
- 
-                }
-                else {
-                    arrow->second.push_back(*symbol);
-                }
+    for (state = states.begin(); state != states.end(); state++) {
+        arrows.clear();
+        TransitionIt it = fa.transitionFunction.lower_bound(std::make_pair(*state, std::numeric_limits<char>::min()));
+        for (; it != fa.transitionFunction.end() and it->first.first == *state; it++) {
+            arrows.push_back(std::make_pair(it->second, (unsigned char)it->first.second));
+        }
+        RangeIt range = fa.rangeTransitionFunction.lower_bound(std::make_pair(*state, lowestrange));
+        for (; range != fa.rangeTransitionFunction.end() and range->first.first == *state; range++) {
+            for (unsigned int c = (unsigned char)range->first.second.first; c <= (unsigned char)range->first.second.second; c++) {
+                arrows.push_back(std::make_pair(range->second, c));
             }
-        } 
-        // Now write a line for each arrow we collected:
-        std::map<std::string, std::vector<char> >::const_iterator arrow;
-        for (arrow = arrows.begin(); arrow != arrows.end(); arrow++) {
-            std::vector<char>::const_iterator ch;
-            std::string label = "";
-            for (ch = arrow->second.begin(); ch != arrow->second.end(); ch++) {
-                if (label != "") {
-                   label += ", ";
+        }
+        if (sampled) {
+            std::vector<std::pair<std::string, unsigned char> >::iterator arrow;
+            for (arrow = arrows.begin(); arrow != arrows.end(); arrow++) {
+                if (sample.count(arrow->first) == 0) {
+                    arrow->first = omitted;
+                    omittedused = true;
                 }
-                label += *ch;
             }
-            os << *state << " -> " << arrow->first << " [ label = \"" << label << "\" ];" << std::endl; 
         }
+        appendDotArrows(buffer, *state, arrows);
+        if (buffer.size() >= dotbuffersize) {
+            os.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    if (omittedused) {
+        buffer += "\"...\" [ shape = none ];\n";
     }
-    os << "}";
+    buffer += "}";
+    os.write(buffer.data(), buffer.size());
+}
+// overloading ostream<< for outputting in .dot format
+std::ostream& operator<<(std::ostream& os, const Automaton& fa) {
+    writeDot(os, fa);
     return os;
 }
 // adds the given states to the automaton, discarding duplicates
@@ -104,11 +354,15 @@ void Automaton::setTransitionFunction(std::multimap<std::pair<std::string, char>
         this->addTransition(it->first, it->second);
     }
 }
+void Automaton::setRangeTransitionFunction(std::multimap<std::pair<std::string, SymbolRange>, std::string> transitionfunction) {
+    std::multimap<std::pair<std::string, SymbolRange>, std::string>::iterator it;
+    for (it = transitionfunction.begin(); it != transitionfunction.end(); it++) {
+        this->addRangeTransition(it->first, it->second);
+    }
+}
 // verifies if the given state is an existing state in the automaton and sets it to start state
 void Automaton::setStartState(std::string state) {
-    std::vector<std::string>::iterator it;
-    it = std::find(this->states.begin(), this->states.end(), state);
-    if (it == this->states.end()) {
+    if (!this->hasState(state)) {
         std::cerr << "Start state not set: state " << state << " unknown in automaton." << std::endl;
     }
     else {
@@ -125,11 +379,11 @@ void Automaton::setAcceptStates(std::vector<std::string> states) {
 // add a symbol to the automaton
 void Automaton::addSymbol(char symbol) {
     // disallow epsilon by default
-    if (symbol == epsilon or symbol == '\0') {
+    if (symbol == epsilon) {
         std::cerr << "Symbol epsilon disallowed. not added" << std::endl;
     }
     else if (this->hasSymbol(symbol)) {
-        std::cerr << "Symbol " << symbol << " already known in automaton, skipping" << std::endl;
+        std::cerr << "Symbol " << symbolToString(symbol) << " already known in automaton, skipping" << std::endl;
     }
     else {
         this->symbols.push_back(symbol);
@@ -142,7 +396,10 @@ void Automaton::addState(std::string state) {
         std::cerr << "State " << state << " already known in automaton, skipping" << std::endl;
     }
     else {
+        this->stateIndex.insert(std::make_pair(state, this->states.size()));
         this->states.push_back(state);
+        this->accepting.push_back(false);
+        this->compacted = false;
     }
 }
 // add an accept state to the automaton
@@ -152,6 +409,7 @@ void Automaton::addAcceptState(std::string state) {
     }
     else if (this->hasState(state)) {
         this->acceptStates.push_back(state);
+        this->accepting[this->stateIndex[state]] = true;
     }
     else {
         std::cerr << "Acceptstate '" << state << "' is not a known state in automaton, skipping." << std::endl;
@@ -170,25 +428,12 @@ bool Automaton::hasSymbol(const char& symbol) const {
 }
 // returns wether a given state exists
 bool Automaton::hasState(std::string state) const {
-    std::vector<std::string>::const_iterator i;
-    i = std::find(this->states.begin(), this->states.end(), state);
-    if (i == this->states.end()) {
-        return false;
-    }
-    else {
-        return true;
-    }
+    return this->stateIndex.count(state) > 0;
 }
 // returns wether a given state is an accept state
 bool Automaton::hasAcceptState(std::string state) const {
-    std::vector<std::string>::const_iterator i;
-    i = std::find(this->acceptStates.begin(), this->acceptStates.end(), state);
-    if (i == this->acceptStates.end()) {
-        return false;
-    }
-    else {
-        return true;
-    }
+    std::map<std::string, size_t>::const_iterator found = this->stateIndex.find(state);
+    return found != this->stateIndex.end() and this->accepting[found->second];
 }
 // returns whether a given transition exists in the automaton
 bool Automaton::hasTransition(const std::pair<std::string, char>& arrow, const std::string& result) const {
@@ -206,18 +451,70 @@ bool Automaton::hasTransition(const std::pair<std::string, char>& arrow, const s
 void Automaton::addTransition(std::pair<std::string, char> arrow, std::string result) {
     if (this->hasState(arrow.first) and this->hasSymbol(arrow.second) and this->hasState(result)) {
         if (this->hasTransition(arrow, result)) {
-            std::cerr << "The transition (" << arrow.first << "," << arrow.second << ',' << result << 
+            std::cerr << "The transition (" << arrow.first << "," << symbolToString(arrow.second) << ',' << result << 
                          ") exists already, skipping." << std::endl;
         }
         else {
             this->transitionFunction.insert(std::make_pair(arrow, result));
+            this->compacted = false;
         }
     }
     else {
-        std::cerr << "Transition (" << arrow.first << "," << arrow.second << ',' << result <<
+        std::cerr << "Transition (" << arrow.first << "," << symbolToString(arrow.second) << ',' << result <<
                      ") not added because it contains a state or symbol that is unknown in the automaton." << std::endl;
     }
 }
+// remove a transition from the automaton
+void Automaton::removeTransition(std::pair<std::string, char> arrow, std::string result) {
+    std::pair<std::multimap<std::pair<std::string, char>, std::string>::iterator, std::multimap<std::pair<std::string, char>, std::string>::iterator> rangeit = this->transitionFunction.equal_range(arrow);
+    std::multimap<std::pair<std::string, char>, std::string>::iterator it;
+    for (it = rangeit.first; it != rangeit.second; it++) {
+        if (it->second == result) {
+            this->transitionFunction.erase(it);
+            this->compacted = false;
+            return;
+        }
+    }
+    std::cerr << "The transition (" << arrow.first << "," << symbolToString(arrow.second) << ',' << result <<
+                 ") doesn't exist, nothing removed." << std::endl;
+}
+// add a transition labelled with a range of symbols. symbols of the range that are not
+// in the alphabet yet are added to it, epsilon can never be part of a range.
+void Automaton::addRangeTransition(std::pair<std::string, SymbolRange> arrow, std::string result) {
+    SymbolRange range = arrow.second;
+    if ((unsigned char)range.first > (unsigned char)range.second) {
+        std::cerr << "Range [" << symbolToString(range.first) << "-" << symbolToString(range.second) <<
+                     "] is empty, transition not added." << std::endl;
+        return;
+    }
+    if (range.first == epsilon) {
+        if (range.second == epsilon) {
+            std::cerr << "Range contains only epsilon, transition not added." << std::endl;
+            return;
+        }
+        range.first = epsilon + 1;
+    }
+    if (!this->hasState(arrow.first) or !this->hasState(result)) {
+        std::cerr << "Range transition from " << arrow.first << " to " << result <<
+                     " not added because it contains a state that is unknown in the automaton." << std::endl;
+        return;
+    }
+    std::pair<std::string, SymbolRange> key(arrow.first, range);
+    std::pair<std::multimap<std::pair<std::string, SymbolRange>, std::string>::iterator, std::multimap<std::pair<std::string, SymbolRange>, std::string>::iterator> rangeit = this->rangeTransitionFunction.equal_range(key);
+    std::multimap<std::pair<std::string, SymbolRange>, std::string>::iterator it;
+    for (it = rangeit.first; it != rangeit.second; it++) {
+        if (it->second == result) {
+            return;
+        }
+    }
+    for (unsigned int value = (unsigned char)range.first; value <= (unsigned char)range.second; value++) {
+        if (!this->hasSymbol(value)) {
+            this->symbols.push_back(value);
+        }
+    }
+    this->rangeTransitionFunction.insert(std::make_pair(key, result));
+    this->compacted = false;
+}
 // return a vector with the symbols of the automaton
 std::vector<char> Automaton::getSymbols() const {
     return this->symbols;
@@ -230,14 +527,87 @@ std::vector<std::string> Automaton::getStates() const {
 std::vector<std::string> Automaton::getAcceptStates() const {
     return this->acceptStates;
 }
-std::multimap<std::pair<std::string, char>, std::string> Automaton::getTransitionFunction(){
+// partition the alphabet into classes of symbols that behave identically: two symbols
+// end up in the same class when every state reaches the same targets on both of them.
+// epsilon is never part of a class. classes are ordered by their first symbol in the alphabet.
+std::vector<std::vector<char> > Automaton::getSymbolClasses() const {
+    typedef std::vector<std::pair<std::string, std::string> > Signature;
+    // collect the (state, target) pairs of every symbol in one pass over the transitions
+    std::map<char, Signature> signatures;
+    std::multimap<std::pair<std::string, char>, std::string>::const_iterator it;
+    for (it = this->transitionFunction.begin(); it != this->transitionFunction.end(); it++) {
+        signatures[it->first.second].push_back(std::make_pair(it->first.first, it->second));
+    }
+    // the bytes between two consecutive range bounds are covered by exactly the same
+    // ranges, so ranges only have to be split into those segments and never into bytes
+    std::vector<bool> bound(257, false);
+    std::multimap<std::pair<std::string, SymbolRange>, std::string>::const_iterator range;
+    for (range = this->rangeTransitionFunction.begin(); range != this->rangeTransitionFunction.end(); range++) {
+        bound[(unsigned char)range->first.second.first] = true;
+        bound[(unsigned char)range->first.second.second + 1] = true;
+    }
+    std::vector<size_t> segment(256, 0);
+    size_t segments = 0;
+    for (int value = 0; value < 256; value++) {
+        if (bound[value] and value > 0) {
+            segments++;
+        }
+        segment[value] = segments;
+    }
+    std::vector<Signature> segmentsignatures(segments + 1);
+    for (range = this->rangeTransitionFunction.begin(); range != this->rangeTransitionFunction.end(); range++) {
+        size_t last = segment[(unsigned char)range->first.second.second];
+        for (size_t i = segment[(unsigned char)range->first.second.first]; i <= last; i++) {
+            segmentsignatures[i].push_back(std::make_pair(range->first.first, range->second));
+        }
+    }
+    // segments with equal ranges share an id
+    std::vector<size_t> segmentid(segmentsignatures.size());
+    std::map<Signature, size_t> segmentindex;
+    for (size_t i = 0; i < segmentsignatures.size(); i++) {
+        std::sort(segmentsignatures[i].begin(), segmentsignatures[i].end());
+        std::map<Signature, size_t>::iterator found = segmentindex.find(segmentsignatures[i]);
+        if (found == segmentindex.end()) {
+            found = segmentindex.insert(std::make_pair(segmentsignatures[i], segmentindex.size())).first;
+        }
+        segmentid[i] = found->second;
+    }
+    std::vector<std::vector<char> > classes;
+    std::map<std::pair<size_t, Signature>, size_t> classindex;
+    std::vector<char>::const_iterator symbol;
+    for (symbol = this->symbols.begin(); symbol != this->symbols.end(); symbol++) {
+        if (*symbol == epsilon) {
+            continue;
+        }
+        Signature& signature = signatures[*symbol];
+        // targets of one (state, symbol) pair are stored in insertion order
+        std::sort(signature.begin(), signature.end());
+        std::pair<size_t, Signature> key(segmentid[segment[(unsigned char)*symbol]], signature);
+        std::map<std::pair<size_t, Signature>, size_t>::iterator found = classindex.find(key);
+        if (found == classindex.end()) {
+            classindex.insert(std::make_pair(key, classes.size()));
+            classes.push_back(std::vector<char>(1, *symbol));
+        }
+        else {
+            classes[found->second].push_back(*symbol);
+        }
+    }
+    return classes;
+}
+std::multimap<std::pair<std::string, char>, std::string> Automaton::getTransitionFunction() const{
 	return this->transitionFunction;
 }
+std::multimap<std::pair<std::string, SymbolRange>, std::string> Automaton::getRangeTransitionFunction() const {
+    return this->rangeTransitionFunction;
+}
 // return the states reached by inputting a given symbol from the given state
 std::vector<std::string> Automaton::delta(std::string state, char symbol) const {
     std::vector<std::string> resultstates;
     if (!this->hasState(state) or !this->hasSymbol(symbol)) {
-        std::cerr << "The given state '" << state << "' or symbol '" << symbol << "' doesn't exist." << std::endl;
+        std::cerr << "The given state '" << state << "' or symbol '" << symbolToString(symbol) << "' doesn't exist." << std::endl;
+    }
+    else if (this->compacted) {
+        this->compactDelta(this->stateIndex.find(state)->second, symbol, resultstates);
     }
     else {
         std::pair<std::multimap<std::pair<std::string, char>, std::string>::const_iterator, std::multimap<std::pair<std::string, char>, std::string>::const_iterator> itrange;
@@ -246,27 +616,41 @@ std::vector<std::string> Automaton::delta(std::string state, char symbol) const
         for (it = itrange.first; it != itrange.second; it++) {
             resultstates.push_back(it->second);
         }
+        // ranges of the state are stored consecutively, starting at the lowest possible key
+        std::multimap<std::pair<std::string, SymbolRange>, std::string>::const_iterator range;
+        range = this->rangeTransitionFunction.lower_bound(std::make_pair(state, lowestrange));
+        for (; range != this->rangeTransitionFunction.end() and range->first.first == state; range++) {
+            if (inRange(symbol, range->first.second) and
+                find(resultstates.begin(), resultstates.end(), range->second) == resultstates.end()) {
+                resultstates.push_back(range->second);
+            }
+        }
     }
     return resultstates;
 }
 // return the states reached by inputting a given symbol from the any of the given states
 std::vector<std::string> Automaton::delta(std::vector<std::string> states, char symbol) const {
     std::vector<std::string> resultstates;
+    // the same order as mergeVector gives, without searching the result for every state
+    std::set<std::string> seen;
     std::vector<std::string>::iterator it;
     for (it = states.begin(); it != states.end(); it++) {
         std::vector<std::string> currentdelta =  this->delta(*it, symbol);
-        mergeVector(resultstates, currentdelta);
+        std::vector<std::string>::iterator target;
+        for (target = currentdelta.begin(); target != currentdelta.end(); target++) {
+            if (seen.insert(*target).second) {
+                resultstates.push_back(*target);
+            }
+        }
     }
     return resultstates;
 }
 // return the states reached by inputting a given string from the given state
 std::vector<std::string> Automaton::delta(std::string state, std::string symbols) const {
-    std::vector<std::string> resultstates;
+    std::vector<std::string> resultstates(1, state);
     std::string::iterator i;
-    for (i = symbols.begin(); i != symbols.end(); i++) {
-        std::vector<std::string> subresults = this->delta(state, *i);
-        // INCOMPLETE
-        // merge with resultstates, remove duplicates
+    for (i = symbols.begin(); i != symbols.end() and !resultstates.empty(); i++) {
+        resultstates = this->delta(resultstates, *i);
     }
     return resultstates;
 }
@@ -277,6 +661,110 @@ std::string Automaton::getStartState() const {
 
 void Automaton::convertToDFA(Automaton&) {}//empty
 
+// rebuild the index of the states and the accept flags
+void Automaton::indexStates() {
+    this->stateIndex.clear();
+    for (size_t i = 0; i < this->states.size(); i++) {
+        this->stateIndex.insert(std::make_pair(this->states[i], i));
+    }
+    this->accepting.assign(this->states.size(), false);
+    std::vector<std::string>::iterator it;
+    for (it = this->acceptStates.begin(); it != this->acceptStates.end(); it++) {
+        std::map<std::string, size_t>::iterator found = this->stateIndex.find(*it);
+        if (found != this->stateIndex.end()) {
+            this->accepting[found->second] = true;
+        }
+    }
+}
+// lay the arrows out per state in three packed arrays. the maps are walked in order, so the
+// arrows of a state come out sorted by symbol (or range) with equal ones in the order they
+// were added, and delta gives the same states in the same order as from the maps
+void Automaton::compact() {
+    size_t count = this->states.size();
+    std::vector<size_t> symbolcount(count + 1, 0);
+    std::vector<size_t> rangecount(count + 1, 0);
+    std::vector<size_t> epsiloncount(count + 1, 0);
+    std::multimap<std::pair<std::string, char>, std::string>::const_iterator it;
+    for (it = this->transitionFunction.begin(); it != this->transitionFunction.end(); it++) {
+        size_t from = this->stateIndex[it->first.first];
+        if (it->first.second == epsilon) {
+            epsiloncount[from + 1]++;
+        }
+        else {
+            symbolcount[from + 1]++;
+        }
+    }
+    std::multimap<std::pair<std::string, SymbolRange>, std::string>::const_iterator range;
+    for (range = this->rangeTransitionFunction.begin(); range != this->rangeTransitionFunction.end(); range++) {
+        rangecount[this->stateIndex[range->first.first] + 1]++;
+    }
+    for (size_t state = 0; state < count; state++) {
+        symbolcount[state + 1] += symbolcount[state];
+        rangecount[state + 1] += rangecount[state];
+        epsiloncount[state + 1] += epsiloncount[state];
+    }
+    this->firstSymbolArrow = symbolcount;
+    this->firstRangeArrow = rangecount;
+    this->firstEpsilonArrow = epsiloncount;
+    this->symbolArrows.resize(symbolcount[count]);
+    this->rangeArrows.resize(rangecount[count]);
+    this->epsilonArrows.resize(epsiloncount[count]);
+    // the counts become the next free position of every state
+    for (it = this->transitionFunction.begin(); it != this->transitionFunction.end(); it++) {
+        size_t from = this->stateIndex[it->first.first];
+        size_t to = this->stateIndex[it->second];
+        if (it->first.second == epsilon) {
+            this->epsilonArrows[epsiloncount[from]++] = to;
+        }
+        else {
+            this->symbolArrows[symbolcount[from]++] = std::make_pair(it->first.second, to);
+        }
+    }
+    for (range = this->rangeTransitionFunction.begin(); range != this->rangeTransitionFunction.end(); range++) {
+        size_t from = this->stateIndex[range->first.first];
+        this->rangeArrows[rangecount[from]++] = std::make_pair(range->first.second, this->stateIndex[range->second]);
+    }
+    this->compacted = true;
+}
+// whether the arrows are laid out by compact
+bool Automaton::isCompact() const {
+    return this->compacted;
+}
+// orders packed arrows by symbol alone, as the transition map does
+struct ArrowSymbolLess {
+    bool operator()(const std::pair<char, size_t>& arrow, char symbol) const {
+        return arrow.first < symbol;
+    }
+    bool operator()(char symbol, const std::pair<char, size_t>& arrow) const {
+        return symbol < arrow.first;
+    }
+};
+// the targets of a state for a symbol: a binary search among its symbol arrows, then every
+// range arrow that holds the symbol and leads somewhere new
+void Automaton::compactDelta(size_t state, char symbol, std::vector<std::string>& resultstates) const {
+    if (symbol == epsilon) {
+        for (size_t i = this->firstEpsilonArrow[state]; i < this->firstEpsilonArrow[state + 1]; i++) {
+            resultstates.push_back(this->states[this->epsilonArrows[i]]);
+        }
+        return;
+    }
+    std::vector<std::pair<char, size_t> >::const_iterator first = this->symbolArrows.begin() + this->firstSymbolArrow[state];
+    std::vector<std::pair<char, size_t> >::const_iterator last = this->symbolArrows.begin() + this->firstSymbolArrow[state + 1];
+    std::pair<std::vector<std::pair<char, size_t> >::const_iterator, std::vector<std::pair<char, size_t> >::const_iterator> found;
+    found = std::equal_range(first, last, symbol, ArrowSymbolLess());
+    std::vector<std::pair<char, size_t> >::const_iterator arrow;
+    for (arrow = found.first; arrow != found.second; arrow++) {
+        resultstates.push_back(this->states[arrow->second]);
+    }
+    for (size_t i = this->firstRangeArrow[state]; i < this->firstRangeArrow[state + 1]; i++) {
+        const std::string& target = this->states[this->rangeArrows[i].second];
+        if (inRange(symbol, this->rangeArrows[i].first) and
+            find(resultstates.begin(), resultstates.end(), target) == resultstates.end()) {
+            resultstates.push_back(target);
+        }
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 // DFA CLASS /////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
@@ -322,9 +810,9 @@ std::string NFA::generateStateName(std::vector<std::string> states) {
 // generates a new state name that doesn't exist yet in the NFA 
 std::string NFA::generateStateName() {
     int iname = 0;
-    std::string name = std::to_string(iname);
+    std::string name;
     do {
-	std::string name = std::to_string(iname);
+        name = std::to_string(iname);
         iname++;
     } while (this->hasState(name));
     return name;
@@ -349,43 +837,406 @@ bool NFA::containsAcceptState(std::vector<std::string> states) {
     }
     return false;
 }
-// recursively adds states to the DFA by looping over the alphabet,
-// adding states according to SSC 
-void NFA::deltaOverSigma(std::vector<std::string>& states, DFA& dfa) {
+// adds states to the DFA by looping over the symbol classes, adding states according
+// to SSC. the targets of a class only need to be computed once, using its first symbol,
+// after which the class gets one arrow per run of consecutive symbols, so ranges are only
+// split where the targets differ. new states are expanded depth first with an explicit
+// stack instead of recursion, which ran out of call stack on large DFAs; a frame keeps the
+// targets of its current class, whose arrows are added once they have been expanded.
+void NFA::deltaOverSigma(std::vector<std::string>& states, DFA& dfa, const std::vector<std::vector<char> >& classes) {
+    struct Frame {
+        std::vector<std::string> states;
+        std::string name;
+        size_t next;
+        std::vector<std::string> targets;
+        bool pending;
+    };
     std::string state = this->generateStateName(states);
-    // only add states if the new state is not yet known (recursion base case)
-    if (!dfa.hasState(state)) {
-        dfa.addState(state);
-        std::vector<char>::iterator it;
-        for (it = this->symbols.begin(); it != this->symbols.end(); it++) {
-            std::vector<std::string> targetstates = this->delta(states, *it);
-            if (targetstates.empty()) {
+    // only add states if the new state is not yet known
+    if (dfa.hasState(state)) {
+        return;
+    }
+    dfa.addState(state);
+    std::vector<Frame> stack(1);
+    stack.back().states = states;
+    stack.back().name = state;
+    stack.back().next = 0;
+    stack.back().pending = false;
+    while (!stack.empty()) {
+        Frame& frame = stack.back();
+        if (frame.pending) {
+            // the targets of the previous class are expanded, add the arrows to them
+            std::string newstate;
+            if (frame.targets.empty()) {
                 // transition to dead state
-                targetstates.push_back(this->generateDeadStateName());
-                this->deltaOverSigma(targetstates, dfa);
-                dfa.addTransition(std::make_pair(state, *it), this->generateDeadStateName());
+                newstate = this->generateDeadStateName();
             }
             else {
-                // transition to new state and recurse over new state  
-                this->deltaOverSigma(targetstates, dfa);
-                std::string newstate = this->generateStateName(targetstates);
-                dfa.addTransition(std::make_pair(state, *it), newstate);
-                if (this->containsAcceptState(targetstates)) {
+                newstate = this->generateStateName(frame.targets);
+                if (this->containsAcceptState(frame.targets)) {
                     if (!dfa.hasAcceptState(newstate)) {
                         dfa.addAcceptState(newstate);
                     }
                 }
             }
+            std::vector<SymbolRange> runs = symbolRuns(classes[frame.next - 1]);
+            std::vector<SymbolRange>::iterator run;
+            for (run = runs.begin(); run != runs.end(); run++) {
+                if (run->first == run->second) {
+                    dfa.addTransition(std::make_pair(frame.name, run->first), newstate);
+                }
+                else {
+                    dfa.addRangeTransition(std::make_pair(frame.name, *run), newstate);
+                }
+            }
+            frame.pending = false;
+        }
+        if (frame.next == classes.size()) {
+            stack.pop_back();
+            continue;
+        }
+        frame.targets = this->delta(frame.states, classes[frame.next].front());
+        frame.next++;
+        frame.pending = true;
+        // the dead state stands for the empty set of states, expanding it only leads back to it
+        std::vector<std::string> targetstates = frame.targets;
+        std::string target;
+        if (targetstates.empty()) {
+            target = this->generateDeadStateName();
+        }
+        else {
+            target = this->generateStateName(targetstates);
+        }
+        if (!dfa.hasState(target)) {
+            dfa.addState(target);
+            // frame is no longer valid after this
+            stack.push_back(Frame());
+            stack.back().states = targetstates;
+            stack.back().name = target;
+            stack.back().next = 0;
+            stack.back().pending = false;
         }
     }
 }
 // constructs an equivalent DFA
 void NFA::convertToDFA(DFA& dfa) {
+    this->compact();
     dfa.setSymbols(this->symbols);
     std::vector<std::string> startvector;
     startvector.push_back(this->getStartState());
-    this->deltaOverSigma(startvector, dfa);
+    this->deltaOverSigma(startvector, dfa, this->getSymbolClasses());
     dfa.setStartState(this->getStartState());
+    // the start state is only marked by deltaOverSigma when some arrow leads back to it
+    if (this->containsAcceptState(startvector) and !dfa.hasAcceptState(this->getStartState())) {
+        dfa.addAcceptState(this->getStartState());
+    }
+}
+// the closure of a state in an NFA is the state itself
+std::vector<std::string> NFA::getClosure(std::string state) const {
+    return std::vector<std::string>(1, state);
+}
+// add a transition for a range of unicode code points. every UTF-8 byte sequence of the
+// range gets its own chain of intermediate states; the chains may share their first byte,
+// which is fine for an NFA and gets merged again by the subset construction.
+void NFA::addCodepointTransition(std::pair<std::string, std::pair<unsigned long, unsigned long> > arrow, std::string result) {
+    unsigned long lo = arrow.second.first;
+    unsigned long hi = arrow.second.second;
+    if (!this->hasState(arrow.first) or !this->hasState(result)) {
+        std::cerr << "Code point transition from " << arrow.first << " to " << result <<
+                     " not added because it contains a state that is unknown in the automaton." << std::endl;
+        return;
+    }
+    if (lo > hi or lo > maxcodepoint) {
+        std::cerr << "Code point range from " << arrow.first << " to " << result << " is empty, not added." << std::endl;
+        return;
+    }
+    // U+0000 would be encoded as the epsilon byte
+    if (lo == 0) {
+        lo = 1;
+    }
+    std::vector<std::vector<SymbolRange> > sequences = utf8Sequences(lo, hi);
+    std::vector<std::vector<SymbolRange> >::iterator sequence;
+    for (sequence = sequences.begin(); sequence != sequences.end(); sequence++) {
+        std::string from = arrow.first;
+        for (size_t i = 0; i < sequence->size(); i++) {
+            std::string to = result;
+            if (i + 1 < sequence->size()) {
+                to = this->generateStateName();
+                this->addState(to);
+            }
+            SymbolRange range = (*sequence)[i];
+            if (range.first == range.second) {
+                if (!this->hasSymbol(range.first)) {
+                    this->symbols.push_back(range.first);
+                }
+                this->addTransition(std::make_pair(from, range.first), to);
+            }
+            else {
+                this->addRangeTransition(std::make_pair(from, range), to);
+            }
+            from = to;
+        }
+    }
+}
+
+// an arrow between numbered states, a single symbol is a range of one symbol
+typedef std::pair<std::pair<int, SymbolRange>, int> IndexedArrow;
+// largest automaton the simulation preorder is computed for, it takes quadratic memory
+static const size_t maxsimulationstates = 2000;
+
+// renumber the states to the given blocks, merging the states of a block and dropping the
+// states in block -1. a block accepts when one of its states does and is named after its
+// first state
+static size_t renumberStates(const std::vector<int>& block, size_t blocks, std::vector<IndexedArrow>& arrows,
+                             int& start, std::vector<bool>& accept, std::vector<int>& names) {
+    std::vector<bool> newaccept(blocks, false);
+    std::vector<int> newnames(blocks, -1);
+    for (size_t state = 0; state < block.size(); state++) {
+        if (block[state] < 0) {
+            continue;
+        }
+        if (accept[state]) {
+            newaccept[block[state]] = true;
+        }
+        if (newnames[block[state]] < 0) {
+            newnames[block[state]] = names[state];
+        }
+    }
+    std::vector<IndexedArrow> newarrows;
+    std::vector<IndexedArrow>::iterator arrow;
+    for (arrow = arrows.begin(); arrow != arrows.end(); arrow++) {
+        int from = block[arrow->first.first];
+        int to = block[arrow->second];
+        if (from >= 0 and to >= 0) {
+            newarrows.push_back(std::make_pair(std::make_pair(from, arrow->first.second), to));
+        }
+    }
+    std::sort(newarrows.begin(), newarrows.end());
+    newarrows.erase(std::unique(newarrows.begin(), newarrows.end()), newarrows.end());
+    arrows.swap(newarrows);
+    accept.swap(newaccept);
+    names.swap(newnames);
+    start = block[start];
+    return blocks;
+}
+// keep the states that can be reached from the start state and can reach an accept state.
+// an automaton with an empty language keeps only its start state
+static size_t trimStates(size_t count, std::vector<IndexedArrow>& arrows, int& start,
+                         std::vector<bool>& accept, std::vector<int>& names) {
+    std::vector<std::vector<int> > successors(count);
+    std::vector<std::vector<int> > predecessors(count);
+    std::vector<IndexedArrow>::iterator arrow;
+    for (arrow = arrows.begin(); arrow != arrows.end(); arrow++) {
+        successors[arrow->first.first].push_back(arrow->second);
+        predecessors[arrow->second].push_back(arrow->first.first);
+    }
+    std::vector<bool> reachable(count, false);
+    std::vector<bool> productive(count, false);
+    std::vector<int> queue(1, start);
+    reachable[start] = true;
+    while (!queue.empty()) {
+        int state = queue.back();
+        queue.pop_back();
+        for (size_t i = 0; i < successors[state].size(); i++) {
+            if (!reachable[successors[state][i]]) {
+                reachable[successors[state][i]] = true;
+                queue.push_back(successors[state][i]);
+            }
+        }
+    }
+    for (size_t state = 0; state < count; state++) {
+        if (accept[state]) {
+            productive[state] = true;
+            queue.push_back(state);
+        }
+    }
+    while (!queue.empty()) {
+        int state = queue.back();
+        queue.pop_back();
+        for (size_t i = 0; i < predecessors[state].size(); i++) {
+            if (!productive[predecessors[state][i]]) {
+                productive[predecessors[state][i]] = true;
+                queue.push_back(predecessors[state][i]);
+            }
+        }
+    }
+    std::vector<int> block(count, -1);
+    size_t blocks = 0;
+    if (!productive[start]) {
+        block[start] = blocks++;
+        arrows.clear();
+    }
+    else {
+        for (size_t state = 0; state < count; state++) {
+            if (reachable[state] and productive[state]) {
+                block[state] = blocks++;
+            }
+        }
+    }
+    return renumberStates(block, blocks, arrows, start, accept, names);
+}
+// coarsest partition refining the given one in which the states of a block have arrows with
+// the same labels into the same blocks (or, backward, from the same blocks). blocks are
+// numbered in the order of their first state
+static size_t bisimulation(size_t count, const std::vector<IndexedArrow>& arrows, bool backward, std::vector<int>& block) {
+    size_t blocks = std::set<int>(block.begin(), block.end()).size();
+    while (true) {
+        std::vector<std::vector<std::pair<SymbolRange, int> > > signatures(count);
+        std::vector<IndexedArrow>::const_iterator arrow;
+        for (arrow = arrows.begin(); arrow != arrows.end(); arrow++) {
+            if (backward) {
+                signatures[arrow->second].push_back(std::make_pair(arrow->first.second, block[arrow->first.first]));
+            }
+            else {
+                signatures[arrow->first.first].push_back(std::make_pair(arrow->first.second, block[arrow->second]));
+            }
+        }
+        std::map<std::pair<int, std::vector<std::pair<SymbolRange, int> > >, int> ids;
+        std::vector<int> refined(count);
+        for (size_t state = 0; state < count; state++) {
+            std::sort(signatures[state].begin(), signatures[state].end());
+            signatures[state].erase(std::unique(signatures[state].begin(), signatures[state].end()), signatures[state].end());
+            int id = ids.size();
+            refined[state] = ids.insert(std::make_pair(std::make_pair(block[state], signatures[state]), id)).first->second;
+        }
+        block.swap(refined);
+        // refining never merges blocks, so the same number of blocks is the same partition
+        if (ids.size() == blocks) {
+            return blocks;
+        }
+        blocks = ids.size();
+    }
+}
+// drop every arrow to a state that is strictly simulated by the target of another arrow with
+// the same origin and label. the simulated state can only accept words the other one accepts
+static void pruneSimulated(size_t count, std::vector<IndexedArrow>& arrows, const std::vector<bool>& accept) {
+    if (count > maxsimulationstates) {
+        return;
+    }
+    // the arrows are sorted, so the arrows of a state are consecutive
+    std::vector<size_t> first(count + 1, arrows.size());
+    for (size_t i = arrows.size(); i > 0; i--) {
+        first[arrows[i - 1].first.first] = i - 1;
+    }
+    for (size_t state = count; state > 0; state--) {
+        if (first[state - 1] > first[state]) {
+            first[state - 1] = first[state];
+        }
+    }
+    // simulates[q * count + r]: r can do everything q can
+    std::vector<bool> simulates(count * count);
+    for (size_t q = 0; q < count; q++) {
+        for (size_t r = 0; r < count; r++) {
+            simulates[q * count + r] = !accept[q] or accept[r];
+        }
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t q = 0; q < count; q++) {
+            for (size_t r = 0; r < count; r++) {
+                if (q == r or !simulates[q * count + r]) {
+                    continue;
+                }
+                for (size_t i = first[q]; i < first[q + 1]; i++) {
+                    bool matched = false;
+                    for (size_t j = first[r]; j < first[r + 1] and !matched; j++) {
+                        matched = arrows[j].first.second == arrows[i].first.second and
+                                  simulates[arrows[i].second * count + arrows[j].second];
+                    }
+                    if (!matched) {
+                        simulates[q * count + r] = false;
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    std::vector<IndexedArrow> kept;
+    for (size_t i = 0; i < arrows.size(); i++) {
+        bool dominated = false;
+        for (size_t j = first[arrows[i].first.first]; j < first[arrows[i].first.first + 1] and !dominated; j++) {
+            int q = arrows[i].second;
+            int r = arrows[j].second;
+            dominated = j != i and arrows[j].first.second == arrows[i].first.second and
+                        simulates[q * count + r] and !simulates[r * count + q];
+        }
+        if (!dominated) {
+            kept.push_back(arrows[i]);
+        }
+    }
+    arrows.swap(kept);
+}
+// shrink the automaton without changing its language. states keep the name of the first
+// state they were merged from
+void NFA::reduce() {
+    std::map<std::string, int> index;
+    for (size_t i = 0; i < this->states.size(); i++) {
+        index[this->states[i]] = i;
+    }
+    if (index.count(this->startState) == 0) {
+        std::cerr << "The start state '" << this->startState << "' is unknown, nothing reduced." << std::endl;
+        return;
+    }
+    size_t count = this->states.size();
+    std::vector<IndexedArrow> arrows;
+    std::multimap<std::pair<std::string, char>, std::string>::const_iterator it;
+    for (it = this->transitionFunction.begin(); it != this->transitionFunction.end(); it++) {
+        SymbolRange label(it->first.second, it->first.second);
+        arrows.push_back(std::make_pair(std::make_pair(index[it->first.first], label), index[it->second]));
+    }
+    std::multimap<std::pair<std::string, SymbolRange>, std::string>::const_iterator range;
+    for (range = this->rangeTransitionFunction.begin(); range != this->rangeTransitionFunction.end(); range++) {
+        arrows.push_back(std::make_pair(std::make_pair(index[range->first.first], range->first.second), index[range->second]));
+    }
+    std::sort(arrows.begin(), arrows.end());
+    arrows.erase(std::unique(arrows.begin(), arrows.end()), arrows.end());
+    int start = index[this->startState];
+    std::vector<bool> accept(count, false);
+    std::vector<int> names(count);
+    for (size_t state = 0; state < count; state++) {
+        accept[state] = this->hasAcceptState(this->states[state]);
+        names[state] = state;
+    }
+    count = trimStates(count, arrows, start, accept, names);
+    // forward bisimilar states accept the same words, backward bisimilar states are reached
+    // by the same words
+    std::vector<int> block(count);
+    for (size_t state = 0; state < count; state++) {
+        block[state] = accept[state] ? 1 : 0;
+    }
+    count = renumberStates(block, bisimulation(count, arrows, false, block), arrows, start, accept, names);
+    block.assign(count, 0);
+    block[start] = 1;
+    count = renumberStates(block, bisimulation(count, arrows, true, block), arrows, start, accept, names);
+    pruneSimulated(count, arrows, accept);
+    count = trimStates(count, arrows, start, accept, names);
+    std::vector<std::string> oldstates;
+    oldstates.swap(this->states);
+    this->acceptStates.clear();
+    this->transitionFunction.clear();
+    this->rangeTransitionFunction.clear();
+    for (size_t state = 0; state < count; state++) {
+        this->states.push_back(oldstates[names[state]]);
+        if (accept[state]) {
+            this->acceptStates.push_back(oldstates[names[state]]);
+        }
+    }
+    this->startState = this->states[start];
+    this->indexStates();
+    this->compacted = false;
+    std::vector<IndexedArrow>::iterator arrow;
+    for (arrow = arrows.begin(); arrow != arrows.end(); arrow++) {
+        const std::string& from = this->states[arrow->first.first];
+        const std::string& to = this->states[arrow->second];
+        if (arrow->first.second.first == arrow->first.second.second) {
+            this->transitionFunction.insert(std::make_pair(std::make_pair(from, arrow->first.second.first), to));
+        }
+        else {
+            this->rangeTransitionFunction.insert(std::make_pair(std::make_pair(from, arrow->first.second), to));
+        }
+    }
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -395,8 +1246,12 @@ void NFA::convertToDFA(DFA& dfa) {
 // return the states reached by inputting a given symbol from the given state, without accounting for epsilon
 std::vector<std::string> ENFA::unclosed_delta(std::string state, char symbol) const {
     std::vector<std::string> resultstates;
-    if (!this->hasState(state) or !this->hasSymbol(symbol)) {
-        std::cerr << "The given state '" << state << "' or symbol '" << symbol << "' doesn't exist." << std::endl;
+    // asking for epsilon is fine even when the alphabet has no epsilon transitions
+    if (!this->hasState(state) or (!this->hasSymbol(symbol) and symbol != epsilon)) {
+        std::cerr << "The given state '" << state << "' or symbol '" << symbolToString(symbol) << "' doesn't exist." << std::endl;
+    }
+    else if (this->compacted) {
+        this->compactDelta(this->stateIndex.find(state)->second, symbol, resultstates);
     }
     else {
         std::pair<std::multimap<std::pair<std::string, char>, std::string>::const_iterator, std::multimap<std::pair<std::string, char>, std::string>::const_iterator> itrange;
@@ -405,6 +1260,17 @@ std::vector<std::string> ENFA::unclosed_delta(std::string state, char symbol) co
         for (it = itrange.first; it != itrange.second; it++) {
             resultstates.push_back(it->second);
         }
+        if (symbol == epsilon) {
+            return resultstates;
+        }
+        std::multimap<std::pair<std::string, SymbolRange>, std::string>::const_iterator range;
+        range = this->rangeTransitionFunction.lower_bound(std::make_pair(state, lowestrange));
+        for (; range != this->rangeTransitionFunction.end() and range->first.first == state; range++) {
+            if (inRange(symbol, range->first.second) and
+                find(resultstates.begin(), resultstates.end(), range->second) == resultstates.end()) {
+                resultstates.push_back(range->second);
+            }
+        }
     }
     return resultstates;
 }
@@ -412,28 +1278,34 @@ std::vector<std::string> ENFA::unclosed_delta(std::string state, char symbol) co
 // return the states reached by inputting a given symbol from the given state
 std::vector<std::string> ENFA::delta(std::string state, char symbol) const {
     std::vector<std::string> resultstates;
+    // the same order as merging every closure into the result, without searching it
+    std::set<std::string> seen;
     std::vector<std::string>::iterator it;
     std::vector<std::string> states = this->getClosure(state);
     for (it = states.begin(); it != states.end(); it++) {
         std::vector<std::string> uncloseddelta =  this->unclosed_delta(*it, symbol);
-            std::vector<std::string>::iterator i;
-            for (i = uncloseddelta.begin(); i != uncloseddelta.end(); i++) {
-                mergeVector(resultstates, getClosure(*i));
+        std::vector<std::string>::iterator i;
+        for (i = uncloseddelta.begin(); i != uncloseddelta.end(); i++) {
+            if (seen.count(*i) > 0) {
+                // its closure is in already
+                continue;
             }
-
-        //mergeVector(resultstates, currentdelta);
+            std::vector<std::string> closure = this->getClosure(*i);
+            std::vector<std::string>::iterator member;
+            for (member = closure.begin(); member != closure.end(); member++) {
+                if (seen.insert(*member).second) {
+                    resultstates.push_back(*member);
+                }
+            }
+        }
     }
     return resultstates;
 }
 
-// add a symbol to the ENFA
+// add a symbol to the ENFA, epsilon (the null byte) is allowed here
 void ENFA::addSymbol(char symbol) {
-    // convert null char to epsilon
-    if (symbol == '\0') {
-        symbol = epsilon;
-    }
     if (this->hasSymbol(symbol)) {
-        std::cerr << "Symbol " << symbol << " already known in automaton, skipping" << std::endl;
+        std::cerr << "Symbol " << symbolToString(symbol) << " already known in automaton, skipping" << std::endl;
     }
     else {
         this->symbols.push_back(symbol);
@@ -447,28 +1319,123 @@ std::vector<std::string> ENFA::getClosure(std::string state) const {
         std::cerr << "State '" << state << "' unknown in automaton while attempting to calculate closure." << std::endl;
         return closure;
     }
-    //if (!this->hasTransition(std::make_pair(state, epsilon), state)) {
-        closure.push_back(state);
-    //}
-    std::vector<std::string> nextlevel = this->unclosed_delta(state, epsilon);
-    std::vector<std::string>::iterator it;
-    for (it = nextlevel.begin(); it != nextlevel.end(); it++) {
-        // prevent loops in recursion:
-        if (find(closure.begin(), closure.end(), *it) == closure.end()) {
-            mergeVector(closure, this->getClosure(*it));
+    // depth first with a stack instead of recursion, so epsilon cycles end; the states come
+    // out in the same order as a recursive walk
+    std::set<std::string> seen;
+    std::vector<std::string> stack(1, state);
+    while (!stack.empty()) {
+        std::string current = stack.back();
+        stack.pop_back();
+        if (!seen.insert(current).second) {
+            continue;
+        }
+        closure.push_back(current);
+        std::vector<std::string> nextlevel = this->unclosed_delta(current, epsilon);
+        std::vector<std::string>::reverse_iterator it;
+        for (it = nextlevel.rbegin(); it != nextlevel.rend(); it++) {
+            if (seen.count(*it) == 0) {
+                stack.push_back(*it);
+            }
         }
     }
     return closure;
 }
 // returns an equivalent DFA
 void ENFA::convertToDFA(DFA& dfa) {
-    dfa.setSymbols(this->symbols);
+    this->compact();
+    // epsilon is no symbol of the DFA
+    std::vector<char> symbols = this->symbols;
+    symbols.erase(std::remove(symbols.begin(), symbols.end(), epsilon), symbols.end());
+    dfa.setSymbols(symbols);
     std::vector<std::string> startvector = this->getClosure(this->getStartState());
-    this->deltaOverSigma(startvector, dfa);
+    this->deltaOverSigma(startvector, dfa, this->getSymbolClasses());
     dfa.setStartState(this->generateStateName(startvector));
+    if (this->containsAcceptState(startvector) and !dfa.hasAcceptState(this->generateStateName(startvector))) {
+        dfa.addAcceptState(this->generateStateName(startvector));
+    }
 
 }
 
+// returns an equivalent NFA without epsilon transitions. a state gets every symbol arrow
+// of the states in its closure and accepts when its closure contains an accept state.
+// states that were only reachable through epsilon arrows are left out.
+void ENFA::removeEpsilons(NFA& nfa) const {
+    // closures are computed once per state instead of once per delta
+    std::map<std::string, std::vector<std::string> > closures;
+    std::vector<std::string>::const_iterator state;
+    for (state = this->states.begin(); state != this->states.end(); state++) {
+        closures[*state] = this->getClosure(*state);
+    }
+    std::map<std::string, std::set<std::pair<char, std::string> > > arrows;
+    std::map<std::string, std::set<std::pair<SymbolRange, std::string> > > rangearrows;
+    std::set<std::string> accepting;
+    for (state = this->states.begin(); state != this->states.end(); state++) {
+        std::vector<std::string>& closure = closures[*state];
+        std::vector<std::string>::iterator member;
+        for (member = closure.begin(); member != closure.end(); member++) {
+            if (this->hasAcceptState(*member)) {
+                accepting.insert(*state);
+            }
+            std::multimap<std::pair<std::string, char>, std::string>::const_iterator it;
+            it = this->transitionFunction.lower_bound(std::make_pair(*member, std::numeric_limits<char>::min()));
+            for (; it != this->transitionFunction.end() and it->first.first == *member; it++) {
+                if (it->first.second != epsilon) {
+                    arrows[*state].insert(std::make_pair(it->first.second, it->second));
+                }
+            }
+            std::multimap<std::pair<std::string, SymbolRange>, std::string>::const_iterator range;
+            range = this->rangeTransitionFunction.lower_bound(std::make_pair(*member, lowestrange));
+            for (; range != this->rangeTransitionFunction.end() and range->first.first == *member; range++) {
+                rangearrows[*state].insert(std::make_pair(range->first.second, range->second));
+            }
+        }
+    }
+    // keep the states reachable from the start state over the new arrows
+    std::vector<std::string> reachable(1, this->startState);
+    std::set<std::string> seen(reachable.begin(), reachable.end());
+    for (size_t i = 0; i < reachable.size(); i++) {
+        std::set<std::pair<char, std::string> >::iterator arrow;
+        for (arrow = arrows[reachable[i]].begin(); arrow != arrows[reachable[i]].end(); arrow++) {
+            if (seen.insert(arrow->second).second) {
+                reachable.push_back(arrow->second);
+            }
+        }
+        std::set<std::pair<SymbolRange, std::string> >::iterator rangearrow;
+        for (rangearrow = rangearrows[reachable[i]].begin(); rangearrow != rangearrows[reachable[i]].end(); rangearrow++) {
+            if (seen.insert(rangearrow->second).second) {
+                reachable.push_back(rangearrow->second);
+            }
+        }
+    }
+    std::vector<char>::const_iterator symbol;
+    for (symbol = this->symbols.begin(); symbol != this->symbols.end(); symbol++) {
+        if (*symbol != epsilon) {
+            nfa.addSymbol(*symbol);
+        }
+    }
+    // keep the original order of the states
+    for (state = this->states.begin(); state != this->states.end(); state++) {
+        if (seen.count(*state) > 0) {
+            nfa.addState(*state);
+            if (accepting.count(*state) > 0) {
+                nfa.addAcceptState(*state);
+            }
+        }
+    }
+    nfa.setStartState(this->startState);
+    std::vector<std::string>::iterator it;
+    for (it = reachable.begin(); it != reachable.end(); it++) {
+        std::set<std::pair<char, std::string> >::iterator arrow;
+        for (arrow = arrows[*it].begin(); arrow != arrows[*it].end(); arrow++) {
+            nfa.addTransition(std::make_pair(*it, arrow->first), arrow->second);
+        }
+        std::set<std::pair<SymbolRange, std::string> >::iterator rangearrow;
+        for (rangearrow = rangearrows[*it].begin(); rangearrow != rangearrows[*it].end(); rangearrow++) {
+            nfa.addRangeTransition(std::make_pair(*it, rangearrow->first), rangearrow->second);
+        }
+    }
+}
+
 std::pair<std::string, std::string> ENFA::unionize(std::pair<std::string, std::string> part1,
                                                        std::pair<std::string, std::string> part2) {
     std::string newstart = this->generateStateName();
@@ -608,9 +1575,6 @@ std::string AutomataParser::readString() {
                 handle.unget();
             }
         }*/
-        if (ch == '\0') {
-            retstr += epsilon;
-        }
     }
     handle.unget();
     return retstr;
@@ -675,14 +1639,25 @@ std::vector<char> AutomataParser::getSymbols() {
             else if (ch == '0') {
                 symbols.push_back(epsilon);
             }
+            else if (ch == 'x' and isxdigit(handle.peek())) {
+                // \xHH for any byte, without two hex digits the characters stay literal
+                char digits[3] = {0, 0, 0};
+                handle.get(digits[0]);
+                if (isxdigit(handle.peek())) {
+                    handle.get(digits[1]);
+                    symbols.push_back((char)strtol(digits, NULL, 16));
+                }
+                else {
+                    handle.unget();
+                    symbols.push_back('\\');
+                    symbols.push_back(ch);
+                }
+            }
             else {
                 symbols.push_back('\\');
                 symbols.push_back(ch);
             }
         }
-        else if (ch == '\0') {
-            symbols.push_back(epsilon);
-        }
         else {
             symbols.push_back(ch);
         }
@@ -692,20 +1667,68 @@ std::vector<char> AutomataParser::getSymbols() {
     closeElement(name);
     return symbols;
 }
-std::multimap<std::pair<std::string, char>, std::string> AutomataParser::getTransitionFunction() {
-    std::multimap<std::pair<std::string, char>, std::string> transitionfunction;
+// decode one symbol of a transition label starting at pos: a plain character, \0 for
+// epsilon, \xHH for a byte, or a backslash escaping the next character.
+// leaves pos right after the symbol
+static bool decodeSymbol(const std::string& label, size_t& pos, char& symbol) {
+    if (pos >= label.length()) {
+        return false;
+    }
+    if (label[pos] != '\\' or pos + 1 >= label.length()) {
+        symbol = label[pos++];
+        return true;
+    }
+    char escaped = label[pos + 1];
+    if (escaped == '0') {
+        symbol = epsilon;
+        pos += 2;
+        return true;
+    }
+    if (escaped == 'x' and pos + 3 < label.length() and
+        isxdigit((unsigned char)label[pos + 2]) and isxdigit((unsigned char)label[pos + 3])) {
+        symbol = (char)strtol(label.substr(pos + 2, 2).c_str(), NULL, 16);
+        pos += 4;
+        return true;
+    }
+    symbol = escaped;
+    pos += 2;
+    return true;
+}
+// decode a U+XXXX code point starting at pos, leaves pos right after the code point
+static bool decodeCodepoint(const std::string& label, size_t& pos, unsigned long& codepoint) {
+    if (label.compare(pos, 2, "U+") != 0) {
+        return false;
+    }
+    pos += 2;
+    size_t begin = pos;
+    while (pos < label.length() and isxdigit((unsigned char)label[pos])) {
+        pos++;
+    }
+    if (pos == begin) {
+        return false;
+    }
+    codepoint = strtoul(label.substr(begin, pos - begin).c_str(), NULL, 16);
+    return true;
+}
+// returns whether the label has the form [lo-hi]
+static bool isRangeLabel(const std::string& label) {
+    return label.length() > 3 and label[0] == '[' and label[label.length() - 1] == ']';
+}
+std::vector<std::pair<std::pair<std::string, std::string>, std::string> > AutomataParser::readTransitions() {
+    std::vector<std::pair<std::pair<std::string, std::string>, std::string> > transitions;
+    handle.clear();
     handle.seekg(0);
     std::string name = "TRANSITIONFUNCTION";
     std::string tname = "T"; // transition tag name
     std::string ename; // element name
     char ch;
     if (!seekTag(name)) {
-        return transitionfunction;
+        return transitions;
     }
     do {
         if (!goNextElement()) {
             std::cerr << "No more transitions or transitionfunction close tag found." << std::endl;
-            return transitionfunction;
+            return transitions;
         }
         ename = getElementName();
         if (ename != "T") {
@@ -732,15 +1755,91 @@ std::multimap<std::pair<std::string, char>, std::string> AutomataParser::getTran
             }
             std::string state2 = readString();
             closeElement("T");
-            if (symbol.length() > 1) {
-                std::cerr << "found more than one character for symbol in transition: " << 
-                             state1 << ", " << symbol << ", " << state2 << ". Using first char." << std::endl;
-            }
-            std::pair<std::string, char> arrow(state1, symbol[0]);
-            transitionfunction.insert(std::pair<std::pair<std::string, char>, std::string>(arrow, state2));
+            transitions.push_back(std::make_pair(std::make_pair(state1, symbol), state2));
         }
     } while (!handle.eof());
- 
+    handle.clear();
+    return transitions;
+}
+// returns the transitions labelled with a single symbol. files that declare epsilon (\0)
+// but no real E symbol may still write epsilon transitions with the old E label.
+std::multimap<std::pair<std::string, char>, std::string> AutomataParser::getTransitionFunction() {
+    std::multimap<std::pair<std::string, char>, std::string> transitionfunction;
+    std::vector<char> symbols = this->getSymbols();
+    bool legacy = find(symbols.begin(), symbols.end(), epsilon) != symbols.end() and
+                  find(symbols.begin(), symbols.end(), legacyepsilon) == symbols.end();
+    std::vector<std::pair<std::pair<std::string, std::string>, std::string> > transitions = this->readTransitions();
+    std::vector<std::pair<std::pair<std::string, std::string>, std::string> >::iterator it;
+    for (it = transitions.begin(); it != transitions.end(); it++) {
+        std::string state1 = it->first.first;
+        std::string label = it->first.second;
+        std::string state2 = it->second;
+        if (isRangeLabel(label)) {
+            continue;
+        }
+        size_t pos = 0;
+        char symbol;
+        if (!decodeSymbol(label, pos, symbol)) {
+            std::cerr << "Empty symbol in transition: " << state1 << ", " << state2 << ". Skipping." << std::endl;
+            continue;
+        }
+        if (pos < label.length()) {
+            std::cerr << "found more than one character for symbol in transition: " << 
+                         state1 << ", " << label << ", " << state2 << ". Using first char." << std::endl;
+        }
+        if (legacy and symbol == legacyepsilon and label.length() == 1) {
+            symbol = epsilon;
+        }
+        std::pair<std::string, char> arrow(state1, symbol);
+        transitionfunction.insert(std::pair<std::pair<std::string, char>, std::string>(arrow, state2));
+    }
+    return transitionfunction;
+}
+// returns the transitions labelled with a byte range [lo-hi], where lo and hi are
+// written like any other symbol (so [\x80-\xFF] is allowed)
+std::multimap<std::pair<std::string, SymbolRange>, std::string> AutomataParser::getRangeTransitionFunction() {
+    std::multimap<std::pair<std::string, SymbolRange>, std::string> transitionfunction;
+    std::vector<std::pair<std::pair<std::string, std::string>, std::string> > transitions = this->readTransitions();
+    std::vector<std::pair<std::pair<std::string, std::string>, std::string> >::iterator it;
+    for (it = transitions.begin(); it != transitions.end(); it++) {
+        std::string label = it->first.second;
+        if (!isRangeLabel(label) or label.compare(1, 2, "U+") == 0) {
+            continue;
+        }
+        size_t pos = 1;
+        char lo, hi;
+        if (!decodeSymbol(label, pos, lo) or pos >= label.length() or label[pos++] != '-' or
+            !decodeSymbol(label, pos, hi) or pos != label.length() - 1) {
+            std::cerr << "Invalid range " << label << " in transition: " << it->first.first << ", " <<
+                         it->second << ". Skipping." << std::endl;
+            continue;
+        }
+        std::pair<std::string, SymbolRange> arrow(it->first.first, SymbolRange(lo, hi));
+        transitionfunction.insert(std::make_pair(arrow, it->second));
+    }
+    return transitionfunction;
+}
+// returns the transitions labelled with a code point range [U+lo-U+hi]
+std::multimap<std::pair<std::string, std::pair<unsigned long, unsigned long> >, std::string> AutomataParser::getCodepointTransitions() {
+    std::multimap<std::pair<std::string, std::pair<unsigned long, unsigned long> >, std::string> transitionfunction;
+    std::vector<std::pair<std::pair<std::string, std::string>, std::string> > transitions = this->readTransitions();
+    std::vector<std::pair<std::pair<std::string, std::string>, std::string> >::iterator it;
+    for (it = transitions.begin(); it != transitions.end(); it++) {
+        std::string label = it->first.second;
+        if (!isRangeLabel(label) or label.compare(1, 2, "U+") != 0) {
+            continue;
+        }
+        size_t pos = 1;
+        unsigned long lo, hi;
+        if (!decodeCodepoint(label, pos, lo) or pos >= label.length() or label[pos++] != '-' or
+            !decodeCodepoint(label, pos, hi) or pos != label.length() - 1) {
+            std::cerr << "Invalid code point range " << label << " in transition: " << it->first.first << ", " <<
+                         it->second << ". Skipping." << std::endl;
+            continue;
+        }
+        std::pair<std::string, std::pair<unsigned long, unsigned long> > arrow(it->first.first, std::make_pair(lo, hi));
+        transitionfunction.insert(std::make_pair(arrow, it->second));
+    }
     return transitionfunction;
 }
 std::string AutomataParser::getStartState() {
@@ -781,6 +1880,7 @@ Automaton AutomataParser::makeAutomaton() {
         dfa->setStartState(this->getStartState());
         dfa->setAcceptStates(this->getAcceptStates());
         dfa->setTransitionFunction(this->getTransitionFunction());
+        dfa->setRangeTransitionFunction(this->getRangeTransitionFunction());
         return *dfa;
     }
     else if (this->getType() == "nfa") {
@@ -790,6 +1890,12 @@ Automaton AutomataParser::makeAutomaton() {
         nfa->setStartState(this->getStartState());
         nfa->setAcceptStates(this->getAcceptStates());
         nfa->setTransitionFunction(this->getTransitionFunction());
+        nfa->setRangeTransitionFunction(this->getRangeTransitionFunction());
+        std::multimap<std::pair<std::string, std::pair<unsigned long, unsigned long> >, std::string> codepoints = this->getCodepointTransitions();
+        std::multimap<std::pair<std::string, std::pair<unsigned long, unsigned long> >, std::string>::iterator it;
+        for (it = codepoints.begin(); it != codepoints.end(); it++) {
+            nfa->addCodepointTransition(it->first, it->second);
+        }
         return *nfa;
     }
     else if (this->getType() == "enfa") {
@@ -799,11 +1905,61 @@ Automaton AutomataParser::makeAutomaton() {
         enfa->setStartState(this->getStartState());
         enfa->setAcceptStates(this->getAcceptStates());
         enfa->setTransitionFunction(this->getTransitionFunction());
+        enfa->setRangeTransitionFunction(this->getRangeTransitionFunction());
+        std::multimap<std::pair<std::string, std::pair<unsigned long, unsigned long> >, std::string> codepoints = this->getCodepointTransitions();
+        std::multimap<std::pair<std::string, std::pair<unsigned long, unsigned long> >, std::string>::iterator it;
+        for (it = codepoints.begin(); it != codepoints.end(); it++) {
+            enfa->addCodepointTransition(it->first, it->second);
+        }
         return *enfa;
     }
     std::cerr << "Unknown type of automaton; returning empty object." << std::endl;
     return *automaton;
 }
+// read the automaton as a DFA: a dfa as it is, an nfa or enfa reduced and then determinized
+bool AutomataParser::makeDFA(DFA& result) {
+    std::string type = this->getType();
+    if (type == "dfa") {
+        result.setStates(this->getStates());
+        result.setSymbols(this->getSymbols());
+        result.setStartState(this->getStartState());
+        result.setAcceptStates(this->getAcceptStates());
+        result.setTransitionFunction(this->getTransitionFunction());
+        result.setRangeTransitionFunction(this->getRangeTransitionFunction());
+        return true;
+    }
+    NFA nfa;
+    ENFA enfa;
+    NFA* automaton;
+    if (type == "nfa") {
+        automaton = &nfa;
+    }
+    else if (type == "enfa") {
+        automaton = &enfa;
+    }
+    else {
+        return false;
+    }
+    automaton->setStates(this->getStates());
+    automaton->setSymbols(this->getSymbols());
+    automaton->setStartState(this->getStartState());
+    automaton->setAcceptStates(this->getAcceptStates());
+    automaton->setTransitionFunction(this->getTransitionFunction());
+    automaton->setRangeTransitionFunction(this->getRangeTransitionFunction());
+    std::multimap<std::pair<std::string, std::pair<unsigned long, unsigned long> >, std::string> codepoints = this->getCodepointTransitions();
+    std::multimap<std::pair<std::string, std::pair<unsigned long, unsigned long> >, std::string>::iterator it;
+    for (it = codepoints.begin(); it != codepoints.end(); it++) {
+        automaton->addCodepointTransition(it->first, it->second);
+    }
+    automaton->reduce();
+    if (type == "enfa") {
+        enfa.convertToDFA(result);
+    }
+    else {
+        nfa.convertToDFA(result);
+    }
+    return true;
+}
 
 //Christophe:
 //REGEX -> DFA (via State Elimination)
@@ -816,20 +1972,34 @@ void printVector(std::vector<std::string> vector){
 	std::cout << std::endl;
 }
 
+// every group of symbols leading from one state to the same target becomes a single arrow,
+// labelled with the union of those symbols. for a DFA these groups are unions of symbol
+// classes, so the state elimination works on classes instead of on individual symbols.
 std::multimap<std::pair<std::string, std::string>, std::string> convertTransitionFunction(std::multimap<std::pair<std::string, char>, std::string> transitionFunction){
-	std::multimap<std::pair<std::string, std::string>, std::string> newTransitionFunction;
+	std::map<std::pair<std::string, std::string>, std::string> labels;
+	std::vector<std::pair<std::string, std::string> > order; // keep the arrows in their original order
 	std::multimap<std::pair<std::string, char>, std::string>::iterator it;
 	for( it = transitionFunction.begin(); it!=transitionFunction.end(); it++){
-		std::pair<std::string,char> x = it->first;
-		std::string p1 = std::get<0>(x);
-		char p2 = std::get<1>(x);
-		std::string p3;
-		std::stringstream ss;
-		ss << p2;
-		ss >> p3;
-		//transitionfunction.insert(std::pair<std::pair<std::string, char>, std::string>(arrow, state2));
-		std::pair<std::string,std::string> paartje (p1,p3);
-		newTransitionFunction.insert(std::pair<std::pair<std::string,std::string>,std::string>(paartje,it->second));
+		std::pair<std::string,std::string> paartje (it->first.first,it->second);
+		std::map<std::pair<std::string, std::string>, std::string>::iterator label = labels.find(paartje);
+		if(label == labels.end()){
+			labels.insert(std::make_pair(paartje,std::string(1,it->first.second)));
+			order.push_back(paartje);
+		}
+		else{
+			label->second += "+";
+			label->second += it->first.second;
+		}
+	}
+	std::multimap<std::pair<std::string, std::string>, std::string> newTransitionFunction;
+	std::vector<std::pair<std::string, std::string> >::iterator arrow;
+	for( arrow = order.begin(); arrow!=order.end(); arrow++){
+		std::string regex = labels[*arrow];
+		if(regex.length() > 1){
+			regex = "("+regex+")";
+		}
+		std::pair<std::string,std::string> paartje (arrow->first,regex);
+		newTransitionFunction.insert(std::pair<std::pair<std::string,std::string>,std::string>(paartje,arrow->second));
 	}
 	return newTransitionFunction;
 }
@@ -939,6 +2109,24 @@ std::string simplify_base_case(std::string s){ //alleen maar haakjes binnenkrijg
 	return s; //niets doen
 }
 
+// returns whether the regex contains a '+' that is not nested inside parentheses
+bool hasTopLevelUnion(std::string s){
+	int diepte = 0;
+	std::string::iterator it;
+	for(it = s.begin(); it != s.end(); it++){
+		if(*it == '('){
+			diepte++;
+		}
+		else if(*it == ')'){
+			diepte--;
+		}
+		else if(*it == '+' && diepte == 0){
+			return true;
+		}
+	}
+	return false;
+}
+
 std::vector<Pos> simplify_2(std::string s){
 	std::vector<Pos> pairs;
 	std::vector<int> stack; //hier slaan we posities '(' in op
@@ -999,6 +2187,10 @@ std::string simplify_parentheses(std::string s){
 			if( (left == ")") || (right == "(" || right == "*")){
 				//dan mag het niet
 			}
+			else if(hasTopLevelUnion(s.substr(i.beginhaak+1,i.lengte-2)) &&
+			        !((left == "" || left == "+" || left == "(") && (right == "" || right == "+" || right == ")"))){
+				//een unie die geconcateneerd wordt moet haar haakjes houden
+			}
 			else{
 				s.replace(i.beginhaak,i.lengte,s.substr(i.beginhaak+1,i.lengte-2));
 				done = false;
@@ -1108,7 +2300,16 @@ void eliminateState(std::string s,std::multimap<std::pair<std::string, std::stri
 			if(QtoP != ""){
 				newregex = "("+QtoP+")"+"+";
 			}
-			newregex += std::get<1>(*Qit);
+			std::string Qregex = std::get<1>(*Qit);
+			std::string Pregex = std::get<1>(*Pit);
+			//een unie moet tussen haakjes voor we ze concateneren
+			if(hasTopLevelUnion(Qregex)){
+				Qregex = "("+Qregex+")";
+			}
+			if(hasTopLevelUnion(Pregex)){
+				Pregex = "("+Pregex+")";
+			}
+			newregex += Qregex;
 			std::vector<std::string>::iterator Sit;
 			std::string Sregex = "";
 			for(Sit = S.begin(); Sit!=S.end();Sit++){
@@ -1121,7 +2322,7 @@ void eliminateState(std::string s,std::multimap<std::pair<std::string, std::stri
 				Sregex = " ";
 			}
 			newregex += "("+Sregex+")*"; // pas op! kan leeg worden
-			newregex += std::get<1>(*Pit);
+			newregex += Pregex;
 			//regex is compleet, maar nu moeten we hem mss nog vereenvoudigen.
 			newregex = simplify(newregex);
 			std::pair<std::string,std::string> start_en_regex (std::get<0>(*Qit),newregex);
@@ -1152,7 +2353,63 @@ void eliminateState(std::string s,std::multimap<std::pair<std::string, std::stri
 }
 
 
-std::string convertToRegex(Automaton a){ //the automaton can be a DFA
+// builds the part of the regex for the accept states from begin up to end: the reduced graph
+// from the start state to that accept state, with every other accept state eliminated. state
+// elimination changes the graph, so every accept state starts from its own copy of it
+struct AcceptStateRegex {
+	const std::multimap<std::pair<std::string, std::string>, std::string>* reduced;
+	const std::vector<std::string>* acceptStates;
+	std::string startState;
+	std::vector<std::string>* parts;
+	void operator()(size_t begin, size_t end, size_t) const {
+		for(size_t i = begin; i < end; i++){
+			const std::string& accept = (*this->acceptStates)[i];
+			std::multimap<std::pair<std::string, std::string>, std::string> regexTransitionFunction = *this->reduced;
+			std::vector<std::string>::const_iterator fill_it;
+			for(fill_it = this->acceptStates->begin(); fill_it != this->acceptStates->end(); fill_it++){
+				if(*fill_it != accept){
+					eliminateState(*fill_it,regexTransitionFunction);
+				}
+			}
+			//nu zijn ze allemaal weg buiten de acceptstate en mss nog de beginstate.
+			std::string& part = (*this->parts)[i];
+			std::multimap<std::pair<std::string, std::string>, std::string>::iterator map_it;
+			if(accept == this->startState){ //speciaal geval R*
+				assert(regexTransitionFunction.size() == 1);
+				for(map_it = regexTransitionFunction.begin(); map_it != regexTransitionFunction.end(); map_it++){
+					part += "+("+map_it->first.second+")*"; //R*
+				}
+			}
+			else{ //two state automaton
+				std::string R = " "; //allemaal de lege taal by default
+				std::string S = " ";
+				std::string T = " ";
+				std::string U = " ";
+				for(map_it = regexTransitionFunction.begin(); map_it != regexTransitionFunction.end(); map_it++){
+					std::string vertrekstaat = map_it->first.first;
+					std::string Rregex = map_it->first.second;
+					std::string eindstaat = map_it->second;
+					if(vertrekstaat == this->startState && eindstaat == this->startState){
+						R = Rregex;
+					}
+					else if(vertrekstaat == this->startState && eindstaat == accept){
+						S = Rregex;
+					}
+					else if(vertrekstaat == accept && eindstaat == accept){
+						U = Rregex;
+					}
+					else if(vertrekstaat == accept && eindstaat == this->startState){
+						T = Rregex;
+					}
+				}
+				//we hebben nu R,S,T en U. Nu gaan we regex bouwen
+				part = "+((("+R+")+("+S+")("+U+")*("+T+"))*("+S+")("+U+")*"+")";
+			}
+		}
+	}
+};
+
+std::string convertToRegex(Automaton a, size_t threads){ //the automaton can be a DFA
 	std::string regex = "";
 	std::vector<char> symbols = a.getSymbols();
 	std::vector<std::string> states = a.getStates();
@@ -1176,6 +2433,14 @@ std::string convertToRegex(Automaton a){ //the automaton can be a DFA
 	//printVector(intermediateStates);
 
 	std::multimap<std::pair<std::string, char>, std::string> transitionFunction = a.getTransitionFunction();
+	//pijlen met een bereik worden een unie van hun symbolen
+	std::multimap<std::pair<std::string, SymbolRange>, std::string> rangeTransitionFunction = a.getRangeTransitionFunction();
+	std::multimap<std::pair<std::string, SymbolRange>, std::string>::iterator range_it;
+	for(range_it = rangeTransitionFunction.begin(); range_it != rangeTransitionFunction.end(); range_it++){
+		for(unsigned int c = (unsigned char)range_it->first.second.first; c <= (unsigned char)range_it->first.second.second; c++){
+			transitionFunction.insert(std::make_pair(std::make_pair(range_it->first.first,(char)c),range_it->second));
+		}
+	}
 	std::multimap<std::pair<std::string, std::string>, std::string> regexTransitionFunction = convertTransitionFunction(transitionFunction);//nieuwe transitiefunctie.
 
 	//printTransitionFunction(regexTransitionFunction);
@@ -1186,61 +2451,19 @@ std::string convertToRegex(Automaton a){ //the automaton can be a DFA
 	}
 	//printTransitionFunction(regexTransitionFunction);
 	//nu moeten we elke acceptoestand als enige overhouden met de begintoestand.
-	//we slaan even de transitiefunctie op zoals ze nu is.
-	std::multimap<std::pair<std::string, std::string>, std::string> backup_regexTransitionFunction = regexTransitionFunction;
-	std::vector<std::string> acceptStates_w_this;
-	for(it = acceptStates.begin(); it != acceptStates.end(); it++){
-		std::vector<std::string>::iterator fill_it;
-		for(fill_it = acceptStates.begin(); fill_it != acceptStates.end(); fill_it++){
-			if(*fill_it != *it){
-				acceptStates_w_this.push_back(*fill_it); //moet gecleared worden na loop!!!
-			}
-		}
-		//printVector(acceptStates_w_this);
-		//acceptStates_w_this bevat nu alle acceptstates buiten de huidige acceptstate waarvoor we willen kijken.
-		for(fill_it = acceptStates_w_this.begin(); fill_it != acceptStates_w_this.end(); fill_it++){
-			eliminateState(*fill_it,regexTransitionFunction);
-		}
-		//nu zijn ze allemaal weg buiten de acceptstate en mss nog de beginstate.
-		std::multimap<std::pair<std::string, std::string>, std::string>::iterator map_it;
-		if(*it == startState){ //speciaal geval R*
-			assert(regexTransitionFunction.size() == 1);
-			for(map_it = regexTransitionFunction.begin(); map_it != regexTransitionFunction.end(); map_it++){
-				std::pair<std::string,std::string> pair = map_it->first;
-				std::string Rregex = std::get<1>(pair);
-				regex += "+("+Rregex+")*"; //R*
-			}
-		}
-		else{ //two state automaton
-			std::string R = " "; //allemaal de lege taal by default
-			std::string S = " ";
-			std::string T = " ";
-			std::string U = " ";
-			for(map_it = regexTransitionFunction.begin(); map_it != regexTransitionFunction.end(); map_it++){
-				std::pair<std::string,std::string> pair = map_it->first;
-				std::string vertrekstaat = std::get<0>(pair);
-				std::string Rregex = std::get<1>(pair);
-				std::string eindstaat = map_it->second;
-				if(vertrekstaat == startState && eindstaat == startState){
-					R = Rregex;
-				}
-				else if(vertrekstaat == startState && eindstaat == *it){
-					S = Rregex;
-				}
-				else if(vertrekstaat == *it && eindstaat == *it){
-					U = Rregex;
-				}
-				else if(vertrekstaat == *it && eindstaat == startState){
-					T = Rregex;
-				}
-			}
-			//we hebben nu R,S,T en U. Nu gaan we regex bouwen
-			regex += "+((("+R+")+("+S+")("+U+")*("+T+"))*("+S+")("+U+")*"+")";
+	//every accept state gives its own part of the regex, from the reduced graph with all other
+	//accept states eliminated. the parts don't depend on each other, so they are built on a
+	//number of threads, each reading the same reduced graph.
+	std::vector<std::string> parts(acceptStates.size());
+	AcceptStateRegex extractor = {&regexTransitionFunction, &acceptStates, startState, &parts};
+	parallelFor(acceptStates.size(), threads, extractor, 1);
+	//the parts are joined in the order of the accept states, simplifying as they come in, so
+	//the result doesn't depend on the number of threads.
+	for(size_t i = 0; i < parts.size(); i++){
+		regex += parts[i];
+		if(acceptStates[i] != startState){
 			regex = simplify(regex);
 		}
-		//alles klaar voor deze optie, nu alles herstellen
-		acceptStates_w_this.clear();
-		regexTransitionFunction = backup_regexTransitionFunction;
 	}
 
 	//std::cout << simplify("a+b+( )*+b+( )*");
@@ -3,6 +3,9 @@
  * accept various weird and invalid inputs. Some syntax errors will generate an error message,
  * but don't count on these to catch all mistakes.
  * verification whether an automaton is valid should happen on the level of the automaton itself.
+ * Transition labels are a single symbol, \0 for epsilon, \xHH for any byte, a byte range
+ * [lo-hi] (e.g. [a-z] or [\x80-\xFF]) or a code point range [U+lo-U+hi] that is compiled
+ * into UTF-8 byte sequences for NFAs and ENFAs.
 **/
 #ifndef AUTOMATA_H_
 #define AUTOMATA_H_
@@ -18,13 +21,37 @@
 const std::string deadstatename = "DEAD";
 const char separator = '_';
 const char padding = '+';
-const char epsilon = 'E';
+// epsilon is the null byte, so every other byte (including 'E') can be a real symbol.
+// files written before this change may still use E in transitions, see AutomataParser.
+const char epsilon = '\0';
+// the legacy spelling of epsilon in transitions of .fa files
+const char legacyepsilon = 'E';
+// highest unicode code point, used to validate code point ranges
+const unsigned long maxcodepoint = 0x10FFFF;
+
+// an inclusive range of symbols labelling a single transition. bounds are compared as
+// unsigned bytes, so [\x80-\xFF] is a valid range.
+typedef std::pair<char, char> SymbolRange;
 
 
 // HELPER FUNCTIONS
 
 // append vectors
 void mergeVector(std::vector<std::string>&, const std::vector<std::string>&);
+// returns whether the symbol lies within the range
+bool inRange(char, const SymbolRange&);
+// split a set of symbols into maximal runs of consecutive bytes
+std::vector<SymbolRange> symbolRuns(std::vector<char>);
+// printable representation of a symbol (escapes epsilon and non printable bytes)
+std::string symbolToString(char);
+// split a range of unicode code points into sequences of byte ranges matching its UTF-8 encoding
+std::vector<std::vector<SymbolRange> > utf8Sequences(unsigned long, unsigned long);
+
+class Automaton;
+// export to dot format through a large output buffer. with a maximum number of states,
+// only the states closest to the start state (breadth first) are written and arrows
+// leaving that sample point to a single placeholder node
+void writeDot(std::ostream&, const Automaton&, size_t maxstates = 0);
 
 // class representing na abstract automaton
 class Automaton {
@@ -32,10 +59,34 @@ class Automaton {
         std::vector<std::string> states;
 	std::vector<char> symbols;
 	std::multimap<std::pair<std::string, char>, std::string> transitionFunction;
+        // transitions labelled with a range of symbols, kept apart so a range is stored only once
+        std::multimap<std::pair<std::string, SymbolRange>, std::string> rangeTransitionFunction;
 	std::string startState;
         std::vector<std::string> acceptStates;
+        // the position of every state in states and whether it accepts, kept up to date by
+        // every change, so looking up a state doesn't walk the list
+        std::map<std::string, size_t> stateIndex;
+        std::vector<bool> accepting;
+        // the arrows in compressed sparse row form, built by compact and dropped by every
+        // change to the arrows or states. the arrows of state s are
+        // symbolArrows[firstSymbolArrow[s]] up to symbolArrows[firstSymbolArrow[s + 1]], as
+        // (symbol, target) sorted by symbol in the order of the transition function; the
+        // same goes for the range arrows and for the epsilon arrows, which are kept apart
+        std::vector<size_t> firstSymbolArrow;
+        std::vector<std::pair<char, size_t> > symbolArrows;
+        std::vector<size_t> firstRangeArrow;
+        std::vector<std::pair<SymbolRange, size_t> > rangeArrows;
+        std::vector<size_t> firstEpsilonArrow;
+        std::vector<size_t> epsilonArrows;
+        bool compacted;
+        // rebuild the state index from states and acceptStates
+        void indexStates();
+        // the targets of a state for a symbol from the arrays built by compact, without
+        // checking the state or symbol
+        void compactDelta(size_t, char, std::vector<std::string>&) const;
         // using ostream for export to dot format
         friend std::ostream& operator<<(std::ostream&, const Automaton&);
+        friend void writeDot(std::ostream&, const Automaton&, size_t);
     public:
         // default constructor
         Automaton();
@@ -55,12 +106,19 @@ class Automaton {
         virtual bool hasTransition(const std::pair<std::string, char>&, const std::string&) const;
         // add a transition to the automaton
 	void addTransition(std::pair<std::string, char>, std::string);
+        // remove a transition from the automaton
+        void removeTransition(std::pair<std::string, char>, std::string);
+        // add a transition labelled with a range of symbols, adding the symbols to the alphabet
+        void addRangeTransition(std::pair<std::string, SymbolRange>, std::string);
         // return a vector with the symbols of the automaton
         std::vector<char> getSymbols() const;
+        // partition the alphabet into classes of symbols that have identical transitions in every state
+        std::vector<std::vector<char> > getSymbolClasses() const;
         // return the states reached by inputting a given symbol from the given state
         virtual std::vector<std::string> delta(std::string, char) const;
         // return the states reached by inputting a given symbol from the any of the given states
         std::vector<std::string> delta(std::vector<std::string> states, char symbol) const;
+        // return the states reached by inputting a given string from the given state
         std::vector<std::string> delta(std::string, std::string) const;
         // return the start state
         std::string getStartState() const;
@@ -69,13 +127,22 @@ class Automaton {
         // return a vector with all the accept states in the automaton
         std::vector<std::string> getAcceptStates() const;
 		//return the multimap from the transition function
-		std::multimap<std::pair<std::string, char>, std::string> getTransitionFunction();
+		std::multimap<std::pair<std::string, char>, std::string> getTransitionFunction() const;
+        // return the multimap with the range labelled transitions
+        std::multimap<std::pair<std::string, SymbolRange>, std::string> getRangeTransitionFunction() const;
         void setStates(std::vector<std::string>);
         void setSymbols(std::vector<char>);
         void setTransitionFunction(std::multimap<std::pair<std::string, char>, std::string>);
+        void setRangeTransitionFunction(std::multimap<std::pair<std::string, SymbolRange>, std::string>);
         void setStartState(std::string);
         void setAcceptStates(std::vector<std::string>);
         virtual void convertToDFA(Automaton&);
+        // lay the arrows out in compressed sparse row form, which delta and the closures use
+        // from then on instead of the transition maps. any later change to the arrows or
+        // states drops them again until the next call
+        void compact();
+        // whether the arrows are laid out by compact
+        bool isCompact() const;
 };
 
 class DFA: public Automaton {
@@ -85,6 +152,7 @@ class DFA: public Automaton {
 
 
 class NFA: public Automaton {
+        friend class IncrementalDeterminizer;
     protected:
         // generates a new unique state name for a vector of state names
         std::string generateStateName(std::vector<std::string>);
@@ -95,12 +163,22 @@ class NFA: public Automaton {
         std::string generateDeadStateName();
         // check if a group of states contains at least one accept state
         bool containsAcceptState(std::vector<std::string>);
-        // recursively adds states to the DFA by looping over the alphabet,
+        // recursively adds states to the DFA by looping over the symbol classes,
         // adding states according to SSC
-        void deltaOverSigma(std::vector<std::string>&, DFA&);
+        void deltaOverSigma(std::vector<std::string>&, DFA&, const std::vector<std::vector<char> >&);
     public:
         // returns an equivalent DFA
         void convertToDFA(DFA&);
+        // return the states reachable from the given state without reading a symbol,
+        // which is only the state itself in an NFA
+        virtual std::vector<std::string> getClosure(std::string) const;
+        // add a transition for a range of unicode code points, compiled into UTF-8 byte
+        // sequences through newly generated intermediate states
+        void addCodepointTransition(std::pair<std::string, std::pair<unsigned long, unsigned long> >, std::string);
+        // shrink the automaton without changing its language: remove useless states, merge
+        // forward and backward bisimilar states and drop arrows to states simulated by a
+        // sibling. epsilon arrows count as an ordinary label, so this works for ENFAs too
+        void reduce();
 };
 
 
@@ -117,6 +195,8 @@ class ENFA: public NFA {
         std::vector<std::string> getClosure(std::string) const;
         // returns an equivalent DFA
         void convertToDFA(DFA&);
+        // returns an equivalent NFA without epsilon transitions and with at most as many states
+        void removeEpsilons(NFA&) const;
         // take the union of two partial ENFAs by connecting their start and end states
         std::pair<std::string, std::string> unionize(std::pair<std::string, 
                                  std::string>, std::pair<std::string, std::string>);
@@ -140,6 +220,8 @@ class AutomataParser {
         void closeElement(std::string);
         std::string readString();
         bool seekTag(std::string);
+        // returns the raw (state, label, state) triplets of all T tags
+        std::vector<std::pair<std::pair<std::string, std::string>, std::string> > readTransitions();
     public:
         // default constructor
         AutomataParser();
@@ -150,13 +232,22 @@ class AutomataParser {
         std::vector<std::string> getStates();
 	std::vector<char> getSymbols();
 	std::multimap<std::pair<std::string, char>, std::string> getTransitionFunction();
+        // transitions with a [lo-hi] byte range label
+        std::multimap<std::pair<std::string, SymbolRange>, std::string> getRangeTransitionFunction();
+        // transitions with a [U+lo-U+hi] code point range label
+        std::multimap<std::pair<std::string, std::pair<unsigned long, unsigned long> >, std::string> getCodepointTransitions();
 	std::string getStartState();
         std::vector<std::string> getAcceptStates();
         Automaton makeAutomaton();
+        // read the automaton as a DFA: a dfa as it is, an nfa or enfa reduced and then
+        // determinized. false (leaving the DFA alone) when the type is unknown
+        bool makeDFA(DFA&);
        
 };
 
 void printVector(std::vector<std::string>);
-std::string convertToRegex(Automaton);
+// the regex of an automaton by state elimination. the accept states are handled on the
+// given number of threads (0 for one per core), the result is the same for any number
+std::string convertToRegex(Automaton, size_t = 0);
 
 #endif
@@ -0,0 +1,440 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <ctime>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cache.h"
+
+const char cachemagic[10] = "FACACHE1\n";
+// temporary files older than this (in seconds) were left by a run that got killed
+static const time_t staletemporary = 3600;
+
+// KEYHASHER CLASS ///////////////////////////////////////////////////////////////
+
+KeyHasher::KeyHasher(): first(0xcbf29ce484222325ULL), second(0x84222325cbf29ce4ULL) {
+}
+// feed one byte to both hashes
+void KeyHasher::addByte(unsigned char byte) {
+    this->first = (this->first ^ byte) * 0x100000001b3ULL;
+    this->second = (this->second ^ (byte ^ 0x5c)) * 0x100000001b3ULL;
+}
+// feed a number as 8 bytes, lowest first
+void KeyHasher::addNumber(uint64_t number) {
+    for (int i = 0; i < 8; i++) {
+        this->addByte(static_cast<unsigned char>(number >> (8 * i)));
+    }
+}
+// feed a string with its length in front
+void KeyHasher::addString(const std::string& text) {
+    this->addNumber(text.size());
+    std::string::const_iterator it;
+    for (it = text.begin(); it != text.end(); it++) {
+        this->addByte(static_cast<unsigned char>(*it));
+    }
+}
+// both hashes after a finalizer that spreads every bit over the word, in hexadecimal
+std::string KeyHasher::getKey() const {
+    uint64_t words[2] = {this->first, this->second};
+    std::string key;
+    for (int w = 0; w < 2; w++) {
+        uint64_t h = words[w];
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        for (int i = 60; i >= 0; i -= 4) {
+            key += "0123456789abcdef"[(h >> i) & 0xf];
+        }
+    }
+    return key;
+}
+
+// HELPER FUNCTIONS //////////////////////////////////////////////////////////////
+
+// the name of the cache entry of an automaton and a conversion
+std::string cacheKey(Automaton& automaton, const std::string& operation) {
+    KeyHasher hasher;
+    hasher.addNumber(cacheversion);
+    hasher.addString(operation);
+    std::vector<std::string> states = automaton.getStates();
+    hasher.addNumber(states.size());
+    std::vector<std::string>::iterator it;
+    for (it = states.begin(); it != states.end(); it++) {
+        hasher.addString(*it);
+    }
+    std::vector<char> symbols = automaton.getSymbols();
+    hasher.addNumber(symbols.size());
+    std::vector<char>::iterator sym;
+    for (sym = symbols.begin(); sym != symbols.end(); sym++) {
+        hasher.addByte(static_cast<unsigned char>(*sym));
+    }
+    std::multimap<std::pair<std::string, char>, std::string> transitions = automaton.getTransitionFunction();
+    hasher.addNumber(transitions.size());
+    std::multimap<std::pair<std::string, char>, std::string>::iterator arrow;
+    for (arrow = transitions.begin(); arrow != transitions.end(); arrow++) {
+        hasher.addString(arrow->first.first);
+        hasher.addByte(static_cast<unsigned char>(arrow->first.second));
+        hasher.addString(arrow->second);
+    }
+    std::multimap<std::pair<std::string, SymbolRange>, std::string> ranges = automaton.getRangeTransitionFunction();
+    hasher.addNumber(ranges.size());
+    std::multimap<std::pair<std::string, SymbolRange>, std::string>::iterator range;
+    for (range = ranges.begin(); range != ranges.end(); range++) {
+        hasher.addString(range->first.first);
+        hasher.addByte(static_cast<unsigned char>(range->first.second.first));
+        hasher.addByte(static_cast<unsigned char>(range->first.second.second));
+        hasher.addString(range->second);
+    }
+    hasher.addString(automaton.getStartState());
+    std::vector<std::string> accepts = automaton.getAcceptStates();
+    hasher.addNumber(accepts.size());
+    for (it = accepts.begin(); it != accepts.end(); it++) {
+        hasher.addString(*it);
+    }
+    return hasher.getKey();
+}
+// a state name is written as its length and its bytes, everything else refers to it by number.
+// names that arrows use without them being states are numbered after the states
+static size_t nameNumber(const std::string& name, std::map<std::string, size_t>& numbers, std::vector<std::string>& names) {
+    std::map<std::string, size_t>::iterator found = numbers.find(name);
+    if (found != numbers.end()) {
+        return found->second;
+    }
+    numbers[name] = names.size();
+    names.push_back(name);
+    return names.size() - 1;
+}
+// a DFA as text that readDFA turns back into the same DFA
+std::string writeDFA(DFA& dfa) {
+    std::map<std::string, size_t> numbers;
+    std::vector<std::string> names = dfa.getStates();
+    for (size_t i = 0; i < names.size(); i++) {
+        numbers.insert(std::make_pair(names[i], i));
+    }
+    size_t states = names.size();
+    std::ostringstream body;
+    body << nameNumber(dfa.getStartState(), numbers, names) << '\n';
+    std::vector<std::string> accepts = dfa.getAcceptStates();
+    body << accepts.size();
+    std::vector<std::string>::iterator it;
+    for (it = accepts.begin(); it != accepts.end(); it++) {
+        body << ' ' << nameNumber(*it, numbers, names);
+    }
+    body << '\n';
+    std::vector<char> symbols = dfa.getSymbols();
+    body << symbols.size();
+    std::vector<char>::iterator sym;
+    for (sym = symbols.begin(); sym != symbols.end(); sym++) {
+        body << ' ' << static_cast<int>(static_cast<unsigned char>(*sym));
+    }
+    body << '\n';
+    std::multimap<std::pair<std::string, char>, std::string> transitions = dfa.getTransitionFunction();
+    body << transitions.size() << '\n';
+    std::multimap<std::pair<std::string, char>, std::string>::iterator arrow;
+    for (arrow = transitions.begin(); arrow != transitions.end(); arrow++) {
+        body << nameNumber(arrow->first.first, numbers, names) << ' '
+             << static_cast<int>(static_cast<unsigned char>(arrow->first.second)) << ' '
+             << nameNumber(arrow->second, numbers, names) << '\n';
+    }
+    std::multimap<std::pair<std::string, SymbolRange>, std::string> ranges = dfa.getRangeTransitionFunction();
+    body << ranges.size() << '\n';
+    std::multimap<std::pair<std::string, SymbolRange>, std::string>::iterator range;
+    for (range = ranges.begin(); range != ranges.end(); range++) {
+        body << nameNumber(range->first.first, numbers, names) << ' '
+             << static_cast<int>(static_cast<unsigned char>(range->first.second.first)) << ' '
+             << static_cast<int>(static_cast<unsigned char>(range->first.second.second)) << ' '
+             << nameNumber(range->second, numbers, names) << '\n';
+    }
+    // the names go first, so the reader knows all of them before the numbers come
+    std::ostringstream text;
+    text << names.size() << ' ' << states << '\n';
+    for (it = names.begin(); it != names.end(); it++) {
+        text << it->size() << ' ' << *it << '\n';
+    }
+    text << body.str();
+    return text.str();
+}
+// read a number below the given limit
+static bool readNumber(std::istream& in, size_t limit, size_t& number) {
+    return (in >> number) and number < limit;
+}
+// read the text of writeDFA, false if it is damaged
+bool readDFA(const std::string& text, DFA& dfa) {
+    std::istringstream in(text);
+    size_t count, states;
+    if (!(in >> count >> states) or states > count or count > text.size()) {
+        return false;
+    }
+    std::vector<std::string> names(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t length;
+        if (!(in >> length) or in.get() != ' ' or length > text.size()) {
+            return false;
+        }
+        names[i].resize(length);
+        if (length > 0 and !in.read(&names[i][0], length)) {
+            return false;
+        }
+    }
+    size_t start, number;
+    if (!readNumber(in, count, start) or !(in >> number) or number > count) {
+        return false;
+    }
+    std::vector<std::string> accepts;
+    for (size_t i = 0; i < number; i++) {
+        size_t accept;
+        if (!readNumber(in, count, accept)) {
+            return false;
+        }
+        accepts.push_back(names[accept]);
+    }
+    if (!(in >> number) or number > 256) {
+        return false;
+    }
+    std::vector<char> symbols;
+    for (size_t i = 0; i < number; i++) {
+        size_t symbol;
+        if (!readNumber(in, 256, symbol)) {
+            return false;
+        }
+        symbols.push_back(static_cast<char>(symbol));
+    }
+    std::multimap<std::pair<std::string, char>, std::string> transitions;
+    if (!(in >> number) or number > text.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < number; i++) {
+        size_t from, symbol, to;
+        if (!readNumber(in, count, from) or !readNumber(in, 256, symbol) or !readNumber(in, count, to)) {
+            return false;
+        }
+        // the arrows were written in order, so every one goes to the end
+        transitions.insert(transitions.end(), std::make_pair(std::make_pair(names[from], static_cast<char>(symbol)), names[to]));
+    }
+    std::multimap<std::pair<std::string, SymbolRange>, std::string> ranges;
+    if (!(in >> number) or number > text.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < number; i++) {
+        size_t from, low, high, to;
+        if (!readNumber(in, count, from) or !readNumber(in, 256, low) or !readNumber(in, 256, high)
+                or !readNumber(in, count, to)) {
+            return false;
+        }
+        SymbolRange label(static_cast<char>(low), static_cast<char>(high));
+        ranges.insert(ranges.end(), std::make_pair(std::make_pair(names[from], label), names[to]));
+    }
+    names.resize(states);
+    dfa.setStates(names);
+    dfa.setSymbols(symbols);
+    dfa.setStartState(names.size() > start ? names[start] : std::string());
+    dfa.setAcceptStates(accepts);
+    dfa.setTransitionFunction(transitions);
+    dfa.setRangeTransitionFunction(ranges);
+    return true;
+}
+// an entry file as seen by evict
+struct CacheFile {
+    struct timespec used;
+    uint64_t size;
+    std::string name;
+    bool operator<(const CacheFile&) const;
+};
+// least recently used first, ties broken by name so the order is always the same
+bool CacheFile::operator<(const CacheFile& other) const {
+    if (this->used.tv_sec != other.used.tv_sec) {
+        return this->used.tv_sec < other.used.tv_sec;
+    }
+    if (this->used.tv_nsec != other.used.tv_nsec) {
+        return this->used.tv_nsec < other.used.tv_nsec;
+    }
+    return this->name < other.name;
+}
+// whether a file name is that of a temporary file of store
+static bool isTemporaryName(const std::string& name) {
+    return name.compare(0, 5, ".tmp-") == 0;
+}
+// make the names in a directory survive a crash, false when that fails
+static bool syncDirectory(const std::string& directory) {
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    return close(fd) == 0 and synced;
+}
+// whether a file name is that of an entry, other files in the directory are left alone
+static bool isEntryName(const std::string& name) {
+    return name.size() == 32 and name.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+// CONVERSIONCACHE CLASS /////////////////////////////////////////////////////////
+
+// a cache in the given directory, which is created when missing
+ConversionCache::ConversionCache(const std::string& directory, uint64_t capacity):
+    directory(directory), capacity(capacity), hits(0), misses(0), written(0) {
+    if (mkdir(directory.c_str(), 0777) != 0 and errno != EEXIST) {
+        std::cerr << "Could not create cache directory " << directory << std::endl;
+    }
+}
+// the path of a file in the cache directory
+std::string ConversionCache::getPath(const std::string& name) const {
+    return this->directory + "/" + name;
+}
+// the value stored under a key and conversion name, false when there is none. a hit marks
+// the entry as used now
+bool ConversionCache::lookup(const std::string& key, const std::string& operation, std::string& value) {
+    std::string path = this->getPath(key);
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        this->misses++;
+        return false;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    std::string entry = contents.str();
+    std::string header = std::string(cachemagic) + operation + "\n";
+    if (entry.compare(0, header.size(), header) != 0) {
+        this->misses++;
+        return false;
+    }
+    value = entry.substr(header.size());
+    // the modification time says when an entry was used last
+    utimes(path.c_str(), NULL);
+    this->hits++;
+    return true;
+}
+// store a value under a key and conversion name, then evict
+bool ConversionCache::store(const std::string& key, const std::string& operation, const std::string& value) {
+    std::ostringstream name;
+    name << ".tmp-" << getpid() << "-" << this->written++;
+    std::string temporary = this->getPath(name.str());
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        std::cerr << "Could not write cache entry " << temporary << std::endl;
+        return false;
+    }
+    std::string entry = std::string(cachemagic) + operation + "\n" + value;
+    size_t done = 0;
+    while (done < entry.size()) {
+        ssize_t count = write(fd, entry.data() + done, entry.size() - done);
+        if (count < 0 and errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        done += count;
+    }
+    // the data has to be on disk before the name is, or a crash could leave an empty entry
+    bool complete = done == entry.size() and fsync(fd) == 0;
+    if (close(fd) != 0 or !complete or rename(temporary.c_str(), this->getPath(key).c_str()) != 0) {
+        std::cerr << "Could not write cache entry " << this->getPath(key) << std::endl;
+        unlink(temporary.c_str());
+        return false;
+    }
+    // and the new name has to be on disk before the entry counts as stored
+    if (!syncDirectory(this->directory)) {
+        std::cerr << "Could not sync cache directory " << this->directory << std::endl;
+    }
+    this->evict();
+    return true;
+}
+// remove temporary files left behind, then the least recently used entries until the cache
+// fits its room
+void ConversionCache::evict() {
+    DIR* handle = opendir(this->directory.c_str());
+    if (handle == NULL) {
+        return;
+    }
+    std::vector<CacheFile> files;
+    uint64_t total = 0;
+    struct dirent* item;
+    while ((item = readdir(handle)) != NULL) {
+        CacheFile file;
+        file.name = item->d_name;
+        struct stat info;
+        if (stat(this->getPath(file.name).c_str(), &info) != 0) {
+            continue;
+        }
+        // temporary files of other stores take room too, until they are old enough to have
+        // been left behind by a run that got killed
+        if (isTemporaryName(file.name)) {
+            if (info.st_mtime + staletemporary < time(NULL)) {
+                unlink(this->getPath(file.name).c_str());
+            }
+            else {
+                total += info.st_size;
+            }
+            continue;
+        }
+        if (!isEntryName(file.name)) {
+            continue;
+        }
+        file.used = info.st_mtim;
+        file.size = info.st_size;
+        total += file.size;
+        files.push_back(file);
+    }
+    closedir(handle);
+    if (total <= this->capacity) {
+        return;
+    }
+    std::sort(files.begin(), files.end());
+    std::vector<CacheFile>::iterator it;
+    for (it = files.begin(); it != files.end() and total > this->capacity; it++) {
+        if (unlink(this->getPath(it->name).c_str()) == 0) {
+            total -= it->size;
+        }
+    }
+}
+// the regex of an automaton, from the cache when it was converted before
+std::string ConversionCache::convertToRegex(Automaton& automaton, size_t threads) {
+    std::string key = cacheKey(automaton, "regex");
+    std::string regex;
+    if (this->lookup(key, "regex", regex)) {
+        return regex;
+    }
+    regex = ::convertToRegex(automaton, threads);
+    this->store(key, "regex", regex);
+    return regex;
+}
+// the DFA of an NFA, from the cache when it was converted before
+void ConversionCache::convertToDFA(NFA& nfa, DFA& dfa) {
+    std::string key = cacheKey(nfa, "nfa-dfa");
+    std::string text;
+    if (this->lookup(key, "nfa-dfa", text) and readDFA(text, dfa)) {
+        return;
+    }
+    nfa.convertToDFA(dfa);
+    this->store(key, "nfa-dfa", writeDFA(dfa));
+}
+// the DFA of an ENFA, from the cache when it was converted before
+void ConversionCache::convertToDFA(ENFA& enfa, DFA& dfa) {
+    std::string key = cacheKey(enfa, "enfa-dfa");
+    std::string text;
+    if (this->lookup(key, "enfa-dfa", text) and readDFA(text, dfa)) {
+        return;
+    }
+    enfa.convertToDFA(dfa);
+    this->store(key, "enfa-dfa", writeDFA(dfa));
+}
+// number of lookups that found their entry
+size_t ConversionCache::getHits() const {
+    return this->hits;
+}
+// number of lookups that didn't
+size_t ConversionCache::getMisses() const {
+    return this->misses;
+}
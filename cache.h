@@ -0,0 +1,86 @@
+/* A cache of conversion results on disk.
+ * ConversionCache keeps the DFA or regex that a conversion produced in a directory, in a file
+ * named after a hash of the automaton that went in, the name of the conversion and the version
+ * of the conversions, so an unchanged input is converted once and read back on every later
+ * run. The hash covers every state, symbol, transition, range transition, the start state and
+ * the accept states in the order the automaton keeps them: the state names and the regex that
+ * come out depend on that order, so automata that only differ in it get entries of their own.
+ * An entry is written to a temporary file that is renamed over its final name, so a reader
+ * (another process or a run that got killed) never sees half an entry. Reading an entry sets
+ * its modification time, and when the entries take more room than the cache may use the ones
+ * that were used longest ago are removed. Temporary files count toward that room, and the ones
+ * a killed run left behind are removed once they are an hour old.
+**/
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+#include "automata.h"
+
+// the first line of every cache entry, followed by the name of the conversion
+extern const char cachemagic[10];
+
+// the version of the conversions and of the text of writeDFA, hashed into every key. raise it
+// whenever convertToRegex, convertToDFA or writeDFA give different results, so entries made
+// by older versions are no longer found (and are evicted in time). 2 leaves epsilon out of the
+// alphabet of the DFA of an ENFA
+static const uint64_t cacheversion = 2;
+
+// the room a cache may use when not told otherwise
+static const uint64_t defaultcachebytes = 64 << 20;
+
+// two 64 bit FNV-1a hashes with different starting points, fed every field with its length
+// in front so no two automata give the same stream of bytes
+class KeyHasher {
+    private:
+        uint64_t first;
+        uint64_t second;
+    public:
+        KeyHasher();
+        void addByte(unsigned char);
+        void addNumber(uint64_t);
+        void addString(const std::string&);
+        // both hashes, as 32 hexadecimal digits
+        std::string getKey() const;
+};
+
+// the name of the cache entry of an automaton and a conversion, 32 hexadecimal digits
+std::string cacheKey(Automaton&, const std::string&);
+
+// a DFA as text that readDFA turns back into the same DFA
+std::string writeDFA(DFA&);
+// read the text of writeDFA, false if it is damaged
+bool readDFA(const std::string&, DFA&);
+
+class ConversionCache {
+    private:
+        std::string directory;
+        uint64_t capacity;
+        size_t hits;
+        size_t misses;
+        // file names of temporary files are unique within the process through this counter
+        size_t written;
+        std::string getPath(const std::string&) const;
+    public:
+        // a cache in the given directory, which is created when missing
+        ConversionCache(const std::string&, uint64_t = defaultcachebytes);
+        // the value stored under a key and conversion name, false when there is none
+        bool lookup(const std::string&, const std::string&, std::string&);
+        // store a value under a key and conversion name, then evict. false when it can't be written
+        bool store(const std::string&, const std::string&, const std::string&);
+        // remove temporary files left behind, then the least recently used entries until the
+        // cache fits its room
+        void evict();
+        // the regex of an automaton, as convertToRegex gives it
+        std::string convertToRegex(Automaton&, size_t = 0);
+        // the DFA of an NFA or ENFA, as their convertToDFA gives it
+        void convertToDFA(NFA&, DFA&);
+        void convertToDFA(ENFA&, DFA&);
+        size_t getHits() const;
+        size_t getMisses() const;
+};
+
+#endif
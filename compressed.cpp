@@ -0,0 +1,215 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <ostream>
+#include "compressed.h"
+
+// HELPER FUNCTIONS //////////////////////////////////////////////////////////////
+
+// the successor that occurs most often in a row, the smallest one of those that tie
+static int commonTarget(std::vector<int> row) {
+    std::sort(row.begin(), row.end());
+    int best = row.empty() ? 0 : row[0];
+    size_t bestcount = 0;
+    size_t i = 0;
+    while (i < row.size()) {
+        size_t j = i;
+        while (j < row.size() and row[j] == row[i]) {
+            j++;
+        }
+        if (j - i > bestcount) {
+            best = row[i];
+            bestcount = j - i;
+        }
+        i = j;
+    }
+    return best;
+}
+
+// the first free slot from the given one on. nextfree points from every taken slot to a
+// later slot, and from every free slot to itself; the path is shortened on the way (path
+// halving), so skipping the taken stretch of the comb vector costs next to nothing
+static size_t findFree(std::vector<size_t>& nextfree, size_t slot) {
+    while (slot < nextfree.size() and nextfree[slot] != slot) {
+        size_t next = nextfree[slot];
+        if (next < nextfree.size()) {
+            nextfree[slot] = nextfree[next];
+        }
+        slot = next;
+    }
+    return slot;
+}
+
+// a distinct row waiting to be packed: its number and the classes that don't go to the default
+struct PackedRow {
+    int row;
+    std::vector<int> classes;
+    std::vector<int> targets;
+};
+
+// packs rows with more entries first, they are the hard ones to fit
+struct MoreEntries {
+    bool operator()(const PackedRow* first, const PackedRow* second) const {
+        if (first->classes.size() != second->classes.size()) {
+            return first->classes.size() > second->classes.size();
+        }
+        return first->row < second->row;
+    }
+};
+
+// COMPRESSEDDFA CLASS ///////////////////////////////////////////////////////////
+
+CompressedDFA::CompressedDFA(): classOf(256, 0), classes(1), rows(1), slots(1), accepting(1, false), start(0), distinct(1) {
+    this->rows[0].base = 0;
+    this->rows[0].row = 0;
+    this->rows[0].fallback = 0;
+    this->slots[0].owner = -1;
+    this->slots[0].target = 0;
+}
+CompressedDFA::CompressedDFA(const CompiledDFA& dfa) {
+    this->compress(dfa);
+}
+// pack the table of a compiled DFA: identical rows are shared, every distinct row keeps its
+// most common successor as default and the rest goes into the comb vector at the first base
+// where it fits
+void CompressedDFA::compress(const CompiledDFA& dfa) {
+    this->classes = dfa.getClassCount();
+    this->classOf.resize(256);
+    for (int byte = 0; byte < 256; byte++) {
+        this->classOf[byte] = dfa.getSymbolClass(byte);
+    }
+    size_t states = dfa.size();
+    this->rows.assign(states, Row());
+    this->accepting.assign(states, false);
+    this->start = dfa.getStart();
+    std::map<std::vector<int>, int> ids;
+    std::vector<PackedRow> packed;
+    std::vector<int> fallbacks;
+    std::vector<int> successors(this->classes);
+    for (size_t state = 0; state < states; state++) {
+        for (size_t c = 0; c < this->classes; c++) {
+            successors[c] = dfa.getTransition(state, c);
+        }
+        this->accepting[state] = dfa.isAccepting(state);
+        std::map<std::vector<int>, int>::iterator found = ids.find(successors);
+        if (found != ids.end()) {
+            this->rows[state].row = found->second;
+            continue;
+        }
+        int id = packed.size();
+        ids.insert(std::make_pair(successors, id));
+        packed.push_back(PackedRow());
+        packed.back().row = id;
+        int fallback = commonTarget(successors);
+        fallbacks.push_back(fallback);
+        for (size_t c = 0; c < this->classes; c++) {
+            if (successors[c] != fallback) {
+                packed.back().classes.push_back(c);
+                packed.back().targets.push_back(successors[c]);
+            }
+        }
+        this->rows[state].row = id;
+    }
+    this->distinct = packed.size();
+    std::vector<PackedRow*> order;
+    for (size_t i = 0; i < packed.size(); i++) {
+        order.push_back(&packed[i]);
+    }
+    std::sort(order.begin(), order.end(), MoreEntries());
+    // every base is followed by room for all classes, so a lookup never leaves the vector
+    Slot empty;
+    empty.owner = -1;
+    empty.target = 0;
+    this->slots.assign(this->classes, empty);
+    std::vector<int> bases(packed.size(), 0);
+    std::vector<size_t> nextfree(this->classes);
+    for (size_t i = 0; i < nextfree.size(); i++) {
+        nextfree[i] = i;
+    }
+    std::vector<PackedRow*>::iterator it;
+    for (it = order.begin(); it != order.end() and !(*it)->classes.empty(); it++) {
+        const PackedRow& row = **it;
+        // only bases that put the first entry on a free slot are tried
+        size_t first = row.classes[0];
+        size_t slot = findFree(nextfree, first);
+        size_t base;
+        while (true) {
+            base = slot - first;
+            if (this->slots.size() < base + this->classes) {
+                size_t old = this->slots.size();
+                this->slots.resize(base + this->classes, empty);
+                nextfree.resize(this->slots.size());
+                for (size_t i = old; i < nextfree.size(); i++) {
+                    nextfree[i] = i;
+                }
+            }
+            size_t i = 1;
+            while (i < row.classes.size() and this->slots[base + row.classes[i]].owner == -1) {
+                i++;
+            }
+            if (i == row.classes.size()) {
+                break;
+            }
+            slot = findFree(nextfree, slot + 1);
+        }
+        for (size_t i = 0; i < row.classes.size(); i++) {
+            this->slots[base + row.classes[i]].owner = row.row;
+            this->slots[base + row.classes[i]].target = row.targets[i];
+            nextfree[base + row.classes[i]] = base + row.classes[i] + 1;
+        }
+        bases[row.row] = base;
+    }
+    // every state gets the base and default of its row, so a step reads one Row
+    for (size_t state = 0; state < states; state++) {
+        this->rows[state].base = bases[this->rows[state].row];
+        this->rows[state].fallback = fallbacks[this->rows[state].row];
+    }
+}
+// return the start state
+int CompressedDFA::getStart() const {
+    return this->start;
+}
+// whether the whole text is accepted
+bool CompressedDFA::accepts(const char* text, size_t length) const {
+    int state = this->start;
+    for (size_t i = 0; i < length and state != 0; i++) {
+        state = this->next(state, text[i]);
+    }
+    return this->accepting[state];
+}
+bool CompressedDFA::accepts(const std::string& text) const {
+    return this->accepts(text.data(), text.size());
+}
+// number of states, including the dead state
+size_t CompressedDFA::size() const {
+    return this->rows.size();
+}
+// number of distinct rows
+size_t CompressedDFA::getRowCount() const {
+    return this->distinct;
+}
+// number of slots in the comb vector
+size_t CompressedDFA::getSlotCount() const {
+    return this->slots.size();
+}
+// bytes of a table with a successor for every state and byte
+size_t CompressedDFA::getDenseBytes() const {
+    return this->size() * 256 * sizeof(int);
+}
+// bytes of the table per state and class and the map from bytes to classes
+size_t CompressedDFA::getClassTableBytes() const {
+    return this->size() * this->classes * sizeof(int) + 256 * sizeof(int);
+}
+// bytes of the rows, the slots and the map from bytes to classes
+size_t CompressedDFA::getBytes() const {
+    return this->rows.size() * sizeof(Row) + this->slots.size() * sizeof(Slot) + 256 * sizeof(int);
+}
+// write the sizes of the three tables, the accept flags are left out of all of them
+void CompressedDFA::writeReport(std::ostream& out) const {
+    out << "states: " << this->size() << ", symbol classes: " << this->classes
+        << ", distinct rows: " << this->distinct << ", slots: " << this->slots.size() << std::endl;
+    out << "dense table (state x byte): " << this->getDenseBytes() << " bytes" << std::endl;
+    out << "class table (state x class): " << this->getClassTableBytes() << " bytes" << std::endl;
+    out << "compressed table: " << this->getBytes() << " bytes" << std::endl;
+}
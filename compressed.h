@@ -0,0 +1,79 @@
+/* Compressed transition tables.
+ * A CompiledDFA keeps a successor for every state and symbol class. In a DFA with many
+ * states and few arrows per state that are not to the dead state (or to one other common
+ * target) most of those entries are the same. CompressedDFA keeps per state only a default
+ * successor and the classes whose successor differs from it, packed into one shared array
+ * the way lexer generators do it (row displacement, the base/next/check comb vector): the
+ * entries of a row are at its base plus the class, and every slot says which row owns it,
+ * so rows can fill each other's holes. States with identical rows share one packed row.
+ * A step is always three array lookups: the class of the byte, the row of the state and the
+ * slot, whose owner tells whether it holds the successor or the default does.
+**/
+#ifndef COMPRESSED_H_
+#define COMPRESSED_H_
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstddef>
+#include "matcher.h"
+
+class CompressedDFA {
+    private:
+        // where a state's row is packed, which row it is and where its other classes lead
+        struct Row {
+            int base;
+            int row;
+            int fallback;
+        };
+        // a slot of the comb vector: the row that owns it and the successor it holds
+        struct Slot {
+            int owner;
+            int target;
+        };
+        std::vector<int> classOf;
+        size_t classes;
+        std::vector<Row> rows;
+        std::vector<Slot> slots;
+        std::vector<bool> accepting;
+        int start;
+        // number of distinct rows
+        size_t distinct;
+    public:
+        CompressedDFA();
+        explicit CompressedDFA(const CompiledDFA&);
+        // pack the table of a compiled DFA
+        void compress(const CompiledDFA&);
+        int next(int, unsigned char) const;
+        bool isAccepting(int) const;
+        int getStart() const;
+        // whether the whole text is accepted
+        bool accepts(const char*, size_t) const;
+        bool accepts(const std::string&) const;
+        // number of states, including the dead state
+        size_t size() const;
+        // number of distinct rows left after sharing identical ones
+        size_t getRowCount() const;
+        // number of slots in the comb vector
+        size_t getSlotCount() const;
+        // bytes taken by a table with a successor for every state and byte, by the table of
+        // successors per state and class that CompiledDFA keeps, and by this one
+        size_t getDenseBytes() const;
+        size_t getClassTableBytes() const;
+        size_t getBytes() const;
+        // write the three sizes and the rows and slots that make them up
+        void writeReport(std::ostream&) const;
+};
+
+// the successor of a state for a byte
+inline int CompressedDFA::next(int state, unsigned char byte) const {
+    const Row& row = this->rows[state];
+    const Slot& slot = this->slots[row.base + this->classOf[byte]];
+    return slot.owner == row.row ? slot.target : row.fallback;
+}
+// whether a state is an accept state
+inline bool CompressedDFA::isAccepting(int state) const {
+    return this->accepting[state];
+}
+
+#endif
@@ -0,0 +1,342 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <cmath>
+#include "counting.h"
+
+// largest DFA whose counts come from matrix powers
+static const size_t maxmatrixstates = 256;
+
+// BIGUNSIGNED CLASS /////////////////////////////////////////////////////////////
+
+BigUnsigned::BigUnsigned() {
+}
+BigUnsigned::BigUnsigned(unsigned long long value) {
+    while (value != 0) {
+        this->limbs.push_back(static_cast<uint32_t>(value));
+        value >>= 32;
+    }
+}
+// add another number times a small factor
+void BigUnsigned::addMultiple(const BigUnsigned& other, uint32_t factor) {
+    if (factor == 0 or other.limbs.empty()) {
+        return;
+    }
+    if (this->limbs.size() < other.limbs.size()) {
+        this->limbs.resize(other.limbs.size(), 0);
+    }
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < other.limbs.size(); i++) {
+        uint64_t sum = static_cast<uint64_t>(other.limbs[i]) * factor + this->limbs[i] + carry;
+        this->limbs[i] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+    }
+    for (; carry != 0 and i < this->limbs.size(); i++) {
+        uint64_t sum = static_cast<uint64_t>(this->limbs[i]) + carry;
+        this->limbs[i] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+    }
+    if (carry != 0) {
+        this->limbs.push_back(static_cast<uint32_t>(carry));
+    }
+}
+// returns whether the number is zero
+bool BigUnsigned::isZero() const {
+    return this->limbs.empty();
+}
+// base 2 logarithm, from the three most significant limbs
+double BigUnsigned::log2() const {
+    if (this->limbs.empty()) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    double top = 0;
+    size_t used = std::min<size_t>(3, this->limbs.size());
+    for (size_t i = 0; i < used; i++) {
+        top = top * 4294967296.0 + this->limbs[this->limbs.size() - 1 - i];
+    }
+    return std::log2(top) + 32.0 * (this->limbs.size() - used);
+}
+// the number in decimal digits, dividing by a billion at a time
+std::string BigUnsigned::toString() const {
+    if (this->limbs.empty()) {
+        return "0";
+    }
+    std::vector<uint32_t> rest(this->limbs);
+    std::vector<uint32_t> groups;
+    while (!rest.empty()) {
+        uint64_t remainder = 0;
+        for (size_t i = rest.size(); i > 0; i--) {
+            uint64_t current = (remainder << 32) | rest[i - 1];
+            rest[i - 1] = static_cast<uint32_t>(current / 1000000000);
+            remainder = current % 1000000000;
+        }
+        groups.push_back(static_cast<uint32_t>(remainder));
+        while (!rest.empty() and rest.back() == 0) {
+            rest.pop_back();
+        }
+    }
+    std::string digits = std::to_string(groups.back());
+    for (size_t i = groups.size() - 1; i > 0; i--) {
+        std::string group = std::to_string(groups[i - 1]);
+        digits += std::string(9 - group.size(), '0') + group;
+    }
+    return digits;
+}
+// returns whether two numbers are equal
+bool BigUnsigned::operator==(const BigUnsigned& other) const {
+    return this->limbs == other.limbs;
+}
+
+// LANGUAGECOUNTER CLASS /////////////////////////////////////////////////////////
+
+LanguageCounter::LanguageCounter(const CompiledDFA& dfa): dfa(dfa) {
+    std::vector<unsigned> bytes(dfa.size(), 0);
+    std::vector<int> targets;
+    this->firstArrow.push_back(0);
+    for (size_t state = 0; state < dfa.size(); state++) {
+        targets.clear();
+        for (int byte = 0; byte < 256 and state != 0; byte++) {
+            int target = dfa.next(state, byte);
+            if (target != 0) {
+                if (bytes[target] == 0) {
+                    targets.push_back(target);
+                }
+                bytes[target]++;
+            }
+        }
+        std::vector<int>::iterator target;
+        for (target = targets.begin(); target != targets.end(); target++) {
+            this->arrows.push_back(std::make_pair(*target, bytes[*target]));
+            bytes[*target] = 0;
+        }
+        this->firstArrow.push_back(this->arrows.size());
+    }
+}
+// counts of the next length from those of the previous one, scaled so the largest is below
+// one. returns the power of two the counts were divided by
+int LanguageCounter::step(const std::vector<double>& previous, std::vector<double>& next) const {
+    next.assign(previous.size(), 0);
+    double largest = 0;
+    for (size_t state = 1; state < previous.size(); state++) {
+        double sum = 0;
+        for (size_t i = this->firstArrow[state]; i < this->firstArrow[state + 1]; i++) {
+            sum += this->arrows[i].second * previous[this->arrows[i].first];
+        }
+        next[state] = sum;
+        largest = std::max(largest, sum);
+    }
+    int exponent = 0;
+    if (largest > 0) {
+        std::frexp(largest, &exponent);
+        for (size_t state = 1; state < next.size(); state++) {
+            next[state] = std::ldexp(next[state], -exponent);
+        }
+    }
+    return exponent;
+}
+// exact number of accepted strings of the given length
+BigUnsigned LanguageCounter::count(size_t length) const {
+    std::vector<BigUnsigned> counts(this->dfa.size());
+    for (size_t state = 1; state < this->dfa.size(); state++) {
+        if (this->dfa.isAccepting(state)) {
+            counts[state] = BigUnsigned(1);
+        }
+    }
+    std::vector<BigUnsigned> next(this->dfa.size());
+    for (size_t k = 0; k < length; k++) {
+        for (size_t state = 1; state < this->dfa.size(); state++) {
+            next[state] = BigUnsigned();
+            for (size_t i = this->firstArrow[state]; i < this->firstArrow[state + 1]; i++) {
+                next[state].addMultiple(counts[this->arrows[i].first], this->arrows[i].second);
+            }
+        }
+        counts.swap(next);
+    }
+    return counts[this->dfa.getStart()];
+}
+// base 2 logarithm of the number of accepted strings of the given length. the matrix powers
+// take about states^3 * log(length) steps against arrows * length for the layers
+double LanguageCounter::log2Count(size_t length) const {
+    double states = this->dfa.size();
+    if (this->dfa.size() <= maxmatrixstates and length > 1 and
+        states * states * states * std::log2(length) < static_cast<double>(this->arrows.size()) * length) {
+        return this->matrixLog2Count(length);
+    }
+    std::vector<double> counts(this->dfa.size(), 0);
+    for (size_t state = 1; state < this->dfa.size(); state++) {
+        counts[state] = this->dfa.isAccepting(state) ? 1 : 0;
+    }
+    std::vector<double> next;
+    long scale = 0;
+    for (size_t k = 0; k < length; k++) {
+        scale += this->step(counts, next);
+        counts.swap(next);
+    }
+    double start = counts[this->dfa.getStart()];
+    if (start == 0) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    return std::log2(start) + scale;
+}
+// log2Count through powers of the transition matrix: the counts of length n are the matrix
+// to the power n applied to the accept states. powers of the matrix commute, so the squares
+// for the bits of n can be applied in any order. every product is scaled like a layer
+double LanguageCounter::matrixLog2Count(size_t length) const {
+    size_t size = this->dfa.size();
+    std::vector<double> power(size * size, 0);
+    for (size_t state = 1; state < size; state++) {
+        for (size_t i = this->firstArrow[state]; i < this->firstArrow[state + 1]; i++) {
+            power[state * size + this->arrows[i].first] = this->arrows[i].second;
+        }
+    }
+    long powerscale = 0;
+    std::vector<double> counts(size, 0);
+    for (size_t state = 1; state < size; state++) {
+        counts[state] = this->dfa.isAccepting(state) ? 1 : 0;
+    }
+    long scale = 0;
+    std::vector<double> product;
+    int exponent;
+    while (true) {
+        if (length & 1) {
+            product.assign(size, 0);
+            double largest = 0;
+            for (size_t row = 0; row < size; row++) {
+                for (size_t column = 0; column < size; column++) {
+                    product[row] += power[row * size + column] * counts[column];
+                }
+                largest = std::max(largest, product[row]);
+            }
+            exponent = 0;
+            if (largest > 0) {
+                std::frexp(largest, &exponent);
+            }
+            for (size_t row = 0; row < size; row++) {
+                counts[row] = std::ldexp(product[row], -exponent);
+            }
+            scale += powerscale + exponent;
+        }
+        length >>= 1;
+        if (length == 0) {
+            break;
+        }
+        product.assign(size * size, 0);
+        double largest = 0;
+        for (size_t row = 0; row < size; row++) {
+            for (size_t middle = 0; middle < size; middle++) {
+                double factor = power[row * size + middle];
+                if (factor == 0) {
+                    continue;
+                }
+                for (size_t column = 0; column < size; column++) {
+                    product[row * size + column] += factor * power[middle * size + column];
+                }
+            }
+        }
+        for (size_t i = 0; i < product.size(); i++) {
+            largest = std::max(largest, product[i]);
+        }
+        exponent = 0;
+        if (largest > 0) {
+            std::frexp(largest, &exponent);
+        }
+        for (size_t i = 0; i < product.size(); i++) {
+            power[i] = std::ldexp(product[i], -exponent);
+        }
+        powerscale = 2 * powerscale + exponent;
+    }
+    double start = counts[this->dfa.getStart()];
+    if (start == 0) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    return std::log2(start) + scale;
+}
+// pick the next byte from a state, given the counts of the remaining length minus one: first
+// a target weighted by its completions times its bytes, then one of those bytes
+char LanguageCounter::pick(int& state, const std::vector<double>& counts, std::mt19937_64& random) const {
+    double total = 0;
+    for (size_t i = this->firstArrow[state]; i < this->firstArrow[state + 1]; i++) {
+        total += this->arrows[i].second * counts[this->arrows[i].first];
+    }
+    double choice = std::uniform_real_distribution<double>(0, total)(random);
+    size_t chosen = this->firstArrow[state];
+    for (size_t i = this->firstArrow[state]; i < this->firstArrow[state + 1]; i++) {
+        double weight = this->arrows[i].second * counts[this->arrows[i].first];
+        if (weight > 0) {
+            chosen = i;
+            if (choice < weight) {
+                break;
+            }
+            choice -= weight;
+        }
+    }
+    unsigned which = std::uniform_int_distribution<unsigned>(0, this->arrows[chosen].second - 1)(random);
+    int target = this->arrows[chosen].first;
+    for (int byte = 0; byte < 256; byte++) {
+        if (this->dfa.next(state, byte) == target) {
+            if (which == 0) {
+                state = target;
+                return static_cast<char>(byte);
+            }
+            which--;
+        }
+    }
+    state = target;
+    return '\0';
+}
+// a uniformly random accepted string of the given length, false when there is none
+bool LanguageCounter::sample(size_t length, std::mt19937_64& random, std::string& result) const {
+    std::vector<std::string> samples;
+    this->sample(length, 1, random, samples);
+    if (samples.empty()) {
+        return false;
+    }
+    result = samples.front();
+    return true;
+}
+// the given number of uniformly random accepted strings of the given length. the counts of
+// length k form layer k; every blocksize-th layer is kept on the way up, and on the way down
+// each block of layers is recomputed from the layer kept at its bottom
+void LanguageCounter::sample(size_t length, size_t amount, std::mt19937_64& random,
+                             std::vector<std::string>& samples) const {
+    size_t blocksize = static_cast<size_t>(std::sqrt(static_cast<double>(length))) + 1;
+    std::vector<std::vector<double> > checkpoints;
+    std::vector<double> counts(this->dfa.size(), 0);
+    for (size_t state = 1; state < this->dfa.size(); state++) {
+        counts[state] = this->dfa.isAccepting(state) ? 1 : 0;
+    }
+    std::vector<double> next;
+    for (size_t k = 0; k < length; k++) {
+        if (k % blocksize == 0) {
+            checkpoints.push_back(counts);
+        }
+        this->step(counts, next);
+        counts.swap(next);
+    }
+    if (counts[this->dfa.getStart()] == 0) {
+        std::cerr << "The language has no strings of length " << length << ", nothing sampled." << std::endl;
+        return;
+    }
+    std::vector<int> states(amount, this->dfa.getStart());
+    std::vector<std::string> strings(amount, std::string(length, '\0'));
+    for (size_t block = checkpoints.size(); block > 0; block--) {
+        size_t low = (block - 1) * blocksize;
+        size_t high = std::min(low + blocksize, length);
+        std::vector<std::vector<double> > layers(1, checkpoints[block - 1]);
+        for (size_t k = low + 1; k < high; k++) {
+            layers.push_back(std::vector<double>());
+            this->step(layers[layers.size() - 2], layers.back());
+        }
+        // the byte at position i leaves length - 1 - i bytes to go
+        for (size_t k = high; k > low; k--) {
+            size_t position = length - k;
+            for (size_t i = 0; i < amount; i++) {
+                strings[i][position] = this->pick(states[i], layers[k - 1 - low], random);
+            }
+        }
+    }
+    samples.insert(samples.end(), strings.begin(), strings.end());
+}
@@ -0,0 +1,68 @@
+/* Counting and sampling the strings of a language by length.
+ * LanguageCounter works on a compiled DFA: the number of accepted strings of length k + 1
+ * from a state is the sum over its arrows of the number of length k from the target, times
+ * the number of bytes on the arrow. Exact counts use BigUnsigned. Logarithms of counts use
+ * doubles that are scaled by a power of two after every length, so they never overflow; for
+ * small DFAs and long strings they come from powers of the transition matrix instead.
+ * Sampling picks every next byte with probability proportional to the number of accepted
+ * strings it can still lead to, so every accepted string of the length is equally likely (up
+ * to double rounding) and nothing is rejected. Only every so many layers of counts are kept,
+ * the others are recomputed one block at a time, so a sample of length n keeps about two
+ * times the square root of n layers in memory.
+**/
+#ifndef COUNTING_H_
+#define COUNTING_H_
+
+#include <vector>
+#include <string>
+#include <random>
+#include <stdint.h>
+#include "matcher.h"
+
+// an arbitrarily large unsigned integer
+class BigUnsigned {
+    private:
+        // 32 bit limbs, least significant first, without leading zero limbs
+        std::vector<uint32_t> limbs;
+    public:
+        BigUnsigned();
+        explicit BigUnsigned(unsigned long long);
+        // add another number times a small factor
+        void addMultiple(const BigUnsigned&, uint32_t);
+        bool isZero() const;
+        // base 2 logarithm, minus infinity for zero
+        double log2() const;
+        // the number in decimal digits
+        std::string toString() const;
+        bool operator==(const BigUnsigned&) const;
+};
+
+class LanguageCounter {
+    private:
+        CompiledDFA dfa;
+        // the arrows of every state grouped by target: the target and the number of bytes
+        // leading there. the arrows of state q are firstArrow[q] up to firstArrow[q + 1]
+        std::vector<size_t> firstArrow;
+        std::vector<std::pair<int, unsigned> > arrows;
+        // counts of the next length from those of the previous one, scaled so the largest
+        // is below one. returns the power of two the counts were divided by
+        int step(const std::vector<double>&, std::vector<double>&) const;
+        // log2Count through powers of the transition matrix
+        double matrixLog2Count(size_t) const;
+        // pick the next byte from a state, given the counts of the remaining length minus one
+        char pick(int&, const std::vector<double>&, std::mt19937_64&) const;
+    public:
+        explicit LanguageCounter(const CompiledDFA&);
+        // exact number of accepted strings of the given length
+        BigUnsigned count(size_t) const;
+        // base 2 logarithm of the number of accepted strings of the given length, minus
+        // infinity when there are none
+        double log2Count(size_t) const;
+        // a uniformly random accepted string of the given length, false when there is none
+        bool sample(size_t, std::mt19937_64&, std::string&) const;
+        // the given number of uniformly random accepted strings of the given length,
+        // recomputing the counts only once for all of them
+        void sample(size_t, size_t, std::mt19937_64&, std::vector<std::string>&) const;
+};
+
+#endif
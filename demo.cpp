@@ -1,14 +1,23 @@
 #include <cstdlib>
 #include <string>
 #include "automata.h"
+#include "cache.h"
 
 
 int main(int argc, char *argv[]) {
-	for(int a = 1; a <argc; ++a){
+	// "-c directory" in front of the files keeps the regexes in a cache in that directory
+	ConversionCache* cache = NULL;
+	int first = 1;
+	if(argc > 2 && std::string(argv[1]) == "-c"){
+		cache = new ConversionCache(argv[2]);
+		first = 3;
+	}
+	for(int a = first; a <argc; ++a){
 		AutomataParser parser(argv[a]);
 		std::string type = parser.getType();
 		std::vector<std::string> states = parser.getStates();
 		std::multimap<std::pair<std::string, char>, std::string> transitions = parser.getTransitionFunction();
+		std::multimap<std::pair<std::string, SymbolRange>, std::string> rangetransitions = parser.getRangeTransitionFunction();
 		std::vector<char> symbols = parser.getSymbols();
 		std::string startState = parser.getStartState();
 		std::vector<std::string> acceptStates = parser.getAcceptStates();
@@ -20,9 +29,12 @@ int main(int argc, char *argv[]) {
 		automaton.setStartState(startState);
 		automaton.setAcceptStates(acceptStates);
 		automaton.setTransitionFunction(transitions); 
+		automaton.setRangeTransitionFunction(rangetransitions);
 
-		std::cout << "The regex for this DFA (" << argv[a] <<") is: " << convertToRegex(automaton) << std::endl;
+		std::string regex = cache != NULL ? cache->convertToRegex(automaton) : convertToRegex(automaton);
+		std::cout << "The regex for this DFA (" << argv[a] <<") is: " << regex << std::endl;
 	}
+	delete cache;
 	/*
     AutomataParser parser("test.fa");
     std::string type = parser.getType();
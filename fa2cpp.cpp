@@ -0,0 +1,249 @@
+/* fa2cpp: turn a .fa file into a standalone C++ header with a matcher for its language.
+ * usage: fa2cpp [-s | -t] [-n name] [-o output] file.fa
+ * The automaton is determinized and minimized here, so the header needs no parsing or
+ * conversion at run time. -t (the default) writes constexpr tables and a loop over them, -s
+ * writes a direct coded state machine with a switch per state. Both define
+ * name::matches(const char*, std::size_t), telling whether the whole buffer is accepted.
+**/
+#include <cstdlib>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include "automata.h"
+#include "matcher.h"
+
+// read a file into a DFA the way its type asks for
+static bool loadDFA(const char* filename, DFA& dfa) {
+    AutomataParser parser(filename);
+    if (!parser.makeDFA(dfa)) {
+        std::cerr << "The file '" << filename << "' doesn't describe a dfa, nfa or enfa." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// the name of the file without directories and extension, usable as an identifier
+static std::string defaultName(const std::string& filename) {
+    std::string name = filename.substr(filename.find_last_of('/') + 1);
+    name = name.substr(0, name.find('.'));
+    for (size_t i = 0; i < name.size(); i++) {
+        if (!isalnum(static_cast<unsigned char>(name[i]))) {
+            name[i] = '_';
+        }
+    }
+    if (name.empty() or isdigit(static_cast<unsigned char>(name[0]))) {
+        name = "fa_" + name;
+    }
+    return name;
+}
+
+// the states reachable from the start state, in breadth first order. state 0 (the dead
+// state) is left out, arrows to it reject
+static std::vector<int> reachableStates(const CompiledDFA& dfa) {
+    std::vector<int> order;
+    std::vector<bool> seen(dfa.size(), false);
+    seen[0] = true;
+    if (dfa.getStart() != 0) {
+        order.push_back(dfa.getStart());
+        seen[dfa.getStart()] = true;
+    }
+    for (size_t i = 0; i < order.size(); i++) {
+        for (size_t c = 0; c < dfa.getClassCount(); c++) {
+            int target = dfa.getTransition(order[i], c);
+            if (!seen[target]) {
+                seen[target] = true;
+                order.push_back(target);
+            }
+        }
+    }
+    return order;
+}
+
+// the smallest unsigned type holding values up to the given maximum
+static std::string integerType(size_t maximum) {
+    if (maximum <= 0xFF) {
+        return "uint8_t";
+    }
+    if (maximum <= 0xFFFF) {
+        return "uint16_t";
+    }
+    return "uint32_t";
+}
+
+// constexpr tables: the symbol class of every byte, the successors per state and class and
+// whether a state accepts. states are renumbered breadth first, with 0 the dead state
+static void writeTable(std::ostream& out, const CompiledDFA& dfa, const std::vector<int>& order) {
+    std::vector<int> number(dfa.size(), 0);
+    for (size_t i = 0; i < order.size(); i++) {
+        number[order[i]] = i + 1;
+    }
+    size_t states = order.size() + 1;
+    size_t classes = dfa.getClassCount();
+    out << "// symbol class of every byte\n";
+    out << "constexpr " << integerType(classes - 1) << " classes[256] = {";
+    for (int byte = 0; byte < 256; byte++) {
+        out << (byte % 16 == 0 ? "\n    " : " ") << dfa.getSymbolClass(byte) << (byte < 255 ? "," : "");
+    }
+    out << "\n};\n";
+    out << "// successor of every state for every class, state 0 rejects everything\n";
+    out << "constexpr " << integerType(states - 1) << " table[" << states << "][" << classes << "] = {\n";
+    for (size_t state = 0; state < states; state++) {
+        out << "    {";
+        for (size_t c = 0; c < classes; c++) {
+            out << (c > 0 ? ", " : "") << (state == 0 ? 0 : number[dfa.getTransition(order[state - 1], c)]);
+        }
+        out << "}" << (state + 1 < states ? "," : "") << "\n";
+    }
+    out << "};\n";
+    out << "constexpr bool accepting[" << states << "] = {";
+    for (size_t state = 0; state < states; state++) {
+        out << (state > 0 ? ", " : "") << (state > 0 and dfa.isAccepting(order[state - 1]) ? "true" : "false");
+    }
+    out << "};\n\n";
+    out << "// whether the whole buffer is accepted\n";
+    out << "inline bool matches(const char* text, std::size_t length) {\n";
+    out << "    unsigned state = " << (order.empty() ? 0 : 1) << ";\n";
+    out << "    for (std::size_t i = 0; i < length && state != 0; i++) {\n";
+    out << "        state = table[state][classes[static_cast<unsigned char>(text[i])]];\n";
+    out << "    }\n";
+    out << "    return accepting[state];\n";
+    out << "}\n";
+}
+
+// a direct coded state machine: a label per state with a switch on the next byte that jumps
+// to the label of the successor, returning at the end of the buffer or on a dead arrow
+static void writeSwitch(std::ostream& out, const CompiledDFA& dfa, const std::vector<int>& order) {
+    std::vector<int> number(dfa.size(), 0);
+    for (size_t i = 0; i < order.size(); i++) {
+        number[order[i]] = i + 1;
+    }
+    out << "// whether the whole buffer is accepted\n";
+    out << "inline bool matches(const char* text, std::size_t length) {\n";
+    if (order.empty()) {
+        out << "    return false;\n}\n";
+        return;
+    }
+    out << "    const char* end = text + length;\n";
+    // the start state comes first, so it only needs a label when an arrow leads back to it
+    bool startlabel = false;
+    for (size_t i = 0; i < order.size(); i++) {
+        for (int byte = 0; byte < 256; byte++) {
+            if (dfa.next(order[i], byte) == order[0]) {
+                startlabel = true;
+            }
+        }
+    }
+    for (size_t i = 0; i < order.size(); i++) {
+        int state = order[i];
+        if (i > 0 or startlabel) {
+            out << "state" << i + 1 << ":\n";
+        }
+        out << "    if (text == end) {\n";
+        out << "        return " << (dfa.isAccepting(state) ? "true" : "false") << ";\n";
+        out << "    }\n";
+        out << "    switch (static_cast<unsigned char>(*text++)) {\n";
+        // the bytes of every live target, in the order the targets first appear
+        std::map<int, std::vector<int> > bytes;
+        std::vector<int> targets;
+        for (int byte = 0; byte < 256; byte++) {
+            int target = dfa.next(state, byte);
+            if (target != 0) {
+                if (bytes[target].empty()) {
+                    targets.push_back(target);
+                }
+                bytes[target].push_back(byte);
+            }
+        }
+        std::vector<int>::iterator target;
+        for (target = targets.begin(); target != targets.end(); target++) {
+            std::vector<int>& list = bytes[*target];
+            for (size_t j = 0; j < list.size(); j++) {
+                out << (j % 8 == 0 ? "        " : " ") << "case 0x" << std::hex << list[j] << std::dec << ":"
+                    << (j % 8 == 7 or j + 1 == list.size() ? "\n" : "");
+            }
+            out << "            goto state" << number[*target] << ";\n";
+        }
+        out << "        default:\n";
+        out << "            return false;\n";
+        out << "    }\n";
+    }
+    out << "}\n";
+}
+
+int main(int argc, char* argv[]) {
+    bool useswitch = false;
+    std::string name;
+    std::string output;
+    std::string input;
+    for (int a = 1; a < argc; a++) {
+        std::string argument = argv[a];
+        if (argument == "-s") {
+            useswitch = true;
+        }
+        else if (argument == "-t") {
+            useswitch = false;
+        }
+        else if ((argument == "-n" or argument == "-o") and a + 1 < argc) {
+            (argument == "-n" ? name : output) = argv[++a];
+        }
+        else if (input.empty() and argument[0] != '-') {
+            input = argument;
+        }
+        else {
+            input.clear();
+            break;
+        }
+    }
+    if (input.empty()) {
+        std::cerr << "usage: " << argv[0] << " [-s | -t] [-n name] [-o output] file.fa" << std::endl;
+        return 1;
+    }
+    if (name.empty()) {
+        name = defaultName(input);
+    }
+    DFA dfa;
+    if (!loadDFA(input.c_str(), dfa)) {
+        return 1;
+    }
+    CompiledDFA compiled(dfa);
+    compiled.minimize();
+    std::vector<int> order = reachableStates(compiled);
+
+    std::ostringstream out;
+    std::string guard = name;
+    for (size_t i = 0; i < guard.size(); i++) {
+        guard[i] = toupper(static_cast<unsigned char>(guard[i]));
+    }
+    guard += "_MATCHER_H_";
+    out << "/* Matcher for " << input << ", generated by fa2cpp: " << order.size() << " states, "
+        << compiled.getClassCount() << " symbol classes.\n";
+    out << " * Do not edit, generate it again instead.\n";
+    out << "**/\n";
+    out << "#ifndef " << guard << "\n#define " << guard << "\n\n";
+    out << "#include <cstddef>\n#include <stdint.h>\n\n";
+    out << "namespace " << name << " {\n\n";
+    if (useswitch) {
+        writeSwitch(out, compiled, order);
+    }
+    else {
+        writeTable(out, compiled, order);
+    }
+    out << "\n}\n\n#endif\n";
+
+    if (output.empty()) {
+        std::cout << out.str();
+    }
+    else {
+        std::ofstream file(output.c_str());
+        file << out.str();
+        if (!file) {
+            std::cerr << "Couldn't write '" << output << "'." << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
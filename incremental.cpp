@@ -0,0 +1,262 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <iostream>
+#include "incremental.h"
+
+// INCREMENTALDETERMINIZER CLASS /////////////////////////////////////////////////
+
+IncrementalDeterminizer::IncrementalDeterminizer(NFA& nfa): nfa(nfa), start(0), converted(false) {
+}
+// returns the id of the subset with the given states, adding it to the worklist when it is new
+size_t IncrementalDeterminizer::findSubset(std::vector<std::string> states, std::vector<size_t>& worklist) {
+    std::sort(states.begin(), states.end());
+    states.erase(std::unique(states.begin(), states.end()), states.end());
+    std::map<std::vector<std::string>, size_t>::iterator found = this->subsetIds.find(states);
+    if (found != this->subsetIds.end()) {
+        return found->second;
+    }
+    size_t id = this->subsets.size();
+    bool accept = false;
+    std::vector<std::string>::iterator it;
+    for (it = states.begin(); it != states.end(); it++) {
+        this->containing[*it].push_back(id);
+        if (this->nfa.hasAcceptState(*it)) {
+            accept = true;
+        }
+    }
+    this->subsetIds.insert(std::make_pair(states, id));
+    this->subsets.push_back(states);
+    this->successors.push_back(std::vector<size_t>());
+    this->alive.push_back(true);
+    this->accepting.push_back(accept);
+    worklist.push_back(id);
+    return id;
+}
+// compute the successors of every subset on the worklist, new subsets are added to it
+size_t IncrementalDeterminizer::explore(std::vector<size_t>& worklist) {
+    size_t computed = 0;
+    while (!worklist.empty()) {
+        size_t id = worklist.back();
+        worklist.pop_back();
+        if (!this->alive[id]) {
+            continue;
+        }
+        // findSubset may grow the vectors, so work on a copy of the members
+        std::vector<std::string> states = this->subsets[id];
+        std::vector<size_t> successors(this->classes.size());
+        for (size_t c = 0; c < this->classes.size(); c++) {
+            successors[c] = this->findSubset(this->nfa.delta(states, this->classes[c].front()), worklist);
+        }
+        this->successors[id] = successors;
+        computed++;
+    }
+    return computed;
+}
+// remove the subsets that can no longer be reached from the start subset
+void IncrementalDeterminizer::collectGarbage() {
+    std::vector<bool> reached(this->subsets.size(), false);
+    std::vector<size_t> queue(1, this->start);
+    reached[this->start] = true;
+    while (!queue.empty()) {
+        size_t id = queue.back();
+        queue.pop_back();
+        std::vector<size_t>::iterator it;
+        for (it = this->successors[id].begin(); it != this->successors[id].end(); it++) {
+            if (!reached[*it]) {
+                reached[*it] = true;
+                queue.push_back(*it);
+            }
+        }
+    }
+    for (size_t id = 0; id < this->subsets.size(); id++) {
+        if (this->alive[id] and !reached[id]) {
+            this->alive[id] = false;
+            this->subsetIds.erase(this->subsets[id]);
+        }
+    }
+}
+// run the full subset construction, forgetting earlier results
+void IncrementalDeterminizer::convert() {
+    this->subsets.clear();
+    this->successors.clear();
+    this->alive.clear();
+    this->accepting.clear();
+    this->subsetIds.clear();
+    this->containing.clear();
+    this->changedStates.clear();
+    this->changedClosures.clear();
+    this->classes = this->nfa.getSymbolClasses();
+    std::vector<size_t> worklist;
+    this->start = this->findSubset(this->nfa.getClosure(this->nfa.getStartState()), worklist);
+    this->explore(worklist);
+    this->converted = true;
+}
+// add a transition to the NFA and remember its origin for the next update
+void IncrementalDeterminizer::addTransition(std::pair<std::string, char> arrow, std::string result) {
+    if (!this->nfa.hasTransition(arrow, result)) {
+        this->nfa.addTransition(arrow, result);
+        this->transitionChanged(arrow.first, arrow.second);
+    }
+}
+// remove a transition from the NFA and remember its origin for the next update
+void IncrementalDeterminizer::removeTransition(std::pair<std::string, char> arrow, std::string result) {
+    if (this->nfa.hasTransition(arrow, result)) {
+        this->nfa.removeTransition(arrow, result);
+        this->transitionChanged(arrow.first, arrow.second);
+    }
+    else {
+        std::cerr << "The transition (" << arrow.first << "," << symbolToString(arrow.second) << ',' << result <<
+                     ") doesn't exist, nothing removed." << std::endl;
+    }
+}
+// an edited symbol transition changes the successors of the subsets containing its origin.
+// an edited epsilon transition changes the closure of its origin, so every subset containing
+// the origin stops being a closed set
+void IncrementalDeterminizer::transitionChanged(std::string state, char symbol) {
+    if (symbol == epsilon) {
+        this->changedClosures.insert(state);
+    }
+    else {
+        this->changedStates.insert(state);
+    }
+}
+// bring the DFA up to date with the edits, returns the number of subsets recomputed
+size_t IncrementalDeterminizer::update() {
+    if (!this->converted) {
+        this->convert();
+        return this->subsetIds.size();
+    }
+    // edits can split or merge symbol classes. for subsets that are not touched by an edit
+    // all symbols of an old class still behave the same, so their successor for a new class
+    // is the successor of the old class of its first symbol
+    std::vector<std::vector<char> > newclasses = this->nfa.getSymbolClasses();
+    if (newclasses != this->classes) {
+        std::map<char, size_t> oldclass;
+        for (size_t c = 0; c < this->classes.size(); c++) {
+            std::vector<char>::iterator symbol;
+            for (symbol = this->classes[c].begin(); symbol != this->classes[c].end(); symbol++) {
+                oldclass[*symbol] = c;
+            }
+        }
+        for (size_t c = 0; c < newclasses.size(); c++) {
+            if (oldclass.count(newclasses[c].front()) == 0) {
+                // the alphabet itself changed
+                this->convert();
+                return this->subsetIds.size();
+            }
+        }
+        for (size_t id = 0; id < this->subsets.size(); id++) {
+            if (!this->alive[id]) {
+                continue;
+            }
+            std::vector<size_t> successors(newclasses.size());
+            for (size_t c = 0; c < newclasses.size(); c++) {
+                successors[c] = this->successors[id][oldclass[newclasses[c].front()]];
+            }
+            this->successors[id] = successors;
+        }
+        this->classes = newclasses;
+    }
+    std::set<size_t> dirty;
+    std::set<std::string>::iterator state;
+    std::vector<size_t>::iterator id;
+    // subsets that are no longer closed disappear, arrows into them are recomputed
+    std::vector<bool> invalid(this->subsets.size(), false);
+    bool anyinvalid = false;
+    for (state = this->changedClosures.begin(); state != this->changedClosures.end(); state++) {
+        std::vector<size_t>& ids = this->containing[*state];
+        for (id = ids.begin(); id != ids.end(); id++) {
+            if (this->alive[*id]) {
+                invalid[*id] = true;
+                anyinvalid = true;
+                this->alive[*id] = false;
+                this->subsetIds.erase(this->subsets[*id]);
+            }
+        }
+    }
+    if (anyinvalid) {
+        for (size_t i = 0; i < this->subsets.size(); i++) {
+            if (!this->alive[i]) {
+                continue;
+            }
+            for (id = this->successors[i].begin(); id != this->successors[i].end(); id++) {
+                if (invalid[*id]) {
+                    dirty.insert(i);
+                    break;
+                }
+            }
+        }
+    }
+    for (state = this->changedStates.begin(); state != this->changedStates.end(); state++) {
+        std::vector<size_t>& ids = this->containing[*state];
+        for (id = ids.begin(); id != ids.end(); id++) {
+            if (this->alive[*id]) {
+                dirty.insert(*id);
+            }
+        }
+    }
+    std::vector<size_t> worklist(dirty.begin(), dirty.end());
+    if (!this->alive[this->start]) {
+        this->start = this->findSubset(this->nfa.getClosure(this->nfa.getStartState()), worklist);
+    }
+    size_t computed = this->explore(worklist);
+    this->collectGarbage();
+    this->changedStates.clear();
+    this->changedClosures.clear();
+    return computed;
+}
+// number of states of the current DFA
+size_t IncrementalDeterminizer::size() const {
+    return this->subsetIds.size();
+}
+// write the current DFA into the given DFA, naming states the same way NFA::convertToDFA does
+void IncrementalDeterminizer::getDFA(DFA& dfa) {
+    if (!this->converted) {
+        this->convert();
+    }
+    dfa.setSymbols(this->nfa.getSymbols());
+    // breadth first from the start subset, so the order of the states is stable
+    std::map<size_t, std::string> names;
+    std::vector<size_t> order(1, this->start);
+    names[this->start] = "";
+    for (size_t i = 0; i < order.size(); i++) {
+        std::vector<size_t>::iterator it;
+        for (it = this->successors[order[i]].begin(); it != this->successors[order[i]].end(); it++) {
+            if (names.insert(std::make_pair(*it, "")).second) {
+                order.push_back(*it);
+            }
+        }
+    }
+    std::vector<size_t>::iterator id;
+    for (id = order.begin(); id != order.end(); id++) {
+        if (this->subsets[*id].empty()) {
+            names[*id] = this->nfa.generateDeadStateName();
+        }
+        else {
+            names[*id] = this->nfa.generateStateName(this->subsets[*id]);
+        }
+        dfa.addState(names[*id]);
+        if (this->accepting[*id]) {
+            dfa.addAcceptState(names[*id]);
+        }
+    }
+    dfa.setStartState(names[this->start]);
+    for (id = order.begin(); id != order.end(); id++) {
+        for (size_t c = 0; c < this->classes.size(); c++) {
+            std::string target = names[this->successors[*id][c]];
+            std::vector<SymbolRange> runs = symbolRuns(this->classes[c]);
+            std::vector<SymbolRange>::iterator run;
+            for (run = runs.begin(); run != runs.end(); run++) {
+                if (run->first == run->second) {
+                    dfa.addTransition(std::make_pair(names[*id], run->first), target);
+                }
+                else {
+                    dfa.addRangeTransition(std::make_pair(names[*id], *run), target);
+                }
+            }
+        }
+    }
+}
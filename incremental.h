@@ -0,0 +1,60 @@
+/* Incremental subset construction for NFAs and ENFAs.
+ * The determinizer remembers which subset of NFA states every DFA state stands for, together
+ * with its successors. When transitions of the NFA are added or removed through the
+ * determinizer (or reported with transitionChanged), update() only recomputes the subsets that
+ * contain an edited state and explores whatever new part of the DFA becomes reachable from them.
+**/
+#ifndef INCREMENTAL_H_
+#define INCREMENTAL_H_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include "automata.h"
+
+class IncrementalDeterminizer {
+    private:
+        IncrementalDeterminizer(const IncrementalDeterminizer&);
+        IncrementalDeterminizer operator=(const IncrementalDeterminizer&);
+        NFA& nfa;
+        // symbol classes the successors are stored for
+        std::vector<std::vector<char> > classes;
+        // sorted NFA states of every DFA state, ids are never reused
+        std::vector<std::vector<std::string> > subsets;
+        // successor id of every DFA state for every symbol class
+        std::vector<std::vector<size_t> > successors;
+        std::vector<bool> alive;
+        std::vector<bool> accepting;
+        std::map<std::vector<std::string>, size_t> subsetIds;
+        // ids of the subsets every NFA state is part of (may contain dead ids)
+        std::map<std::string, std::vector<size_t> > containing;
+        size_t start;
+        bool converted;
+        // origin states of edited symbol transitions and of edited epsilon transitions
+        std::set<std::string> changedStates;
+        std::set<std::string> changedClosures;
+        // returns the id of a subset, adding it to the worklist when it is new
+        size_t findSubset(std::vector<std::string>, std::vector<size_t>&);
+        // compute the successors of the subsets on the worklist until it is empty
+        size_t explore(std::vector<size_t>&);
+        // remove the subsets that can no longer be reached from the start subset
+        void collectGarbage();
+    public:
+        IncrementalDeterminizer(NFA&);
+        // run the full subset construction, forgetting earlier results
+        void convert();
+        // add or remove a transition of the NFA and remember the edit for the next update
+        void addTransition(std::pair<std::string, char>, std::string);
+        void removeTransition(std::pair<std::string, char>, std::string);
+        // report a transition of the given state and symbol that was edited directly on the NFA
+        void transitionChanged(std::string, char);
+        // bring the DFA up to date with the edits, returns the number of subsets recomputed
+        size_t update();
+        // number of states of the current DFA
+        size_t size() const;
+        // write the current DFA into the given (empty) DFA
+        void getDFA(DFA&);
+};
+
+#endif
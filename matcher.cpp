@@ -0,0 +1,800 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <stdint.h>
+#include "matcher.h"
+
+// longest literal prefix the prefilter extracts
+static const size_t maxprefix = 64;
+
+const char compiledmagic[9] = "FADFA01\n";
+
+// HELPER FUNCTIONS //////////////////////////////////////////////////////////////
+
+// have the memory at an address loaded into the cache ahead of its use, on compilers that
+// can be asked to
+static inline void prefetch(const void* address) {
+#ifdef __GNUC__
+    __builtin_prefetch(address);
+#else
+    (void) address;
+#endif
+}
+
+// returns the id of a set of states, adding it when it is new
+static int findSet(std::vector<int> set, std::map<std::vector<int>, int>& ids, std::vector<std::vector<int> >& sets) {
+    std::sort(set.begin(), set.end());
+    set.erase(std::unique(set.begin(), set.end()), set.end());
+    std::map<std::vector<int>, int>::iterator found = ids.find(set);
+    if (found != ids.end()) {
+        return found->second;
+    }
+    int id = sets.size();
+    ids.insert(std::make_pair(set, id));
+    sets.push_back(set);
+    return id;
+}
+
+// COMPILEDDFA CLASS /////////////////////////////////////////////////////////////
+
+CompiledDFA::CompiledDFA(): classOf(256, 0), classes(1), table(1, 0), accepting(1, false), start(0) {
+}
+CompiledDFA::CompiledDFA(const DFA& dfa): classOf(256, 0), classes(1), table(1, 0), accepting(1, false), start(0) {
+    this->compile(dfa);
+}
+// build the table for a DFA, missing transitions lead to the dead state
+void CompiledDFA::compile(const DFA& dfa) {
+    std::vector<std::string> states = dfa.getStates();
+    std::map<std::string, int> index;
+    for (size_t i = 0; i < states.size(); i++) {
+        index[states[i]] = i + 1;
+    }
+    std::vector<std::vector<char> > symbolclasses = dfa.getSymbolClasses();
+    this->classes = symbolclasses.size() + 1;
+    this->classOf.assign(256, 0);
+    for (size_t c = 0; c < symbolclasses.size(); c++) {
+        std::vector<char>::iterator symbol;
+        for (symbol = symbolclasses[c].begin(); symbol != symbolclasses[c].end(); symbol++) {
+            this->classOf[static_cast<unsigned char>(*symbol)] = c + 1;
+        }
+    }
+    this->table.assign((states.size() + 1) * this->classes, 0);
+    this->accepting.assign(states.size() + 1, false);
+    for (size_t i = 0; i < states.size(); i++) {
+        this->accepting[i + 1] = dfa.hasAcceptState(states[i]);
+        for (size_t c = 0; c < symbolclasses.size(); c++) {
+            std::vector<std::string> result = dfa.delta(states[i], symbolclasses[c].front());
+            if (!result.empty()) {
+                this->table[(i + 1) * this->classes + c + 1] = index[result.front()];
+            }
+        }
+    }
+    std::map<std::string, int>::iterator found = index.find(dfa.getStartState());
+    this->start = found == index.end() ? 0 : found->second;
+    this->trim();
+}
+// take over a table built elsewhere, then send the dead ends to the dead state
+void CompiledDFA::setTable(const std::vector<int>& classof, size_t classes, std::vector<int>& table,
+                           std::vector<bool>& accepting, int start) {
+    this->classOf = classof;
+    this->classes = classes;
+    this->table.swap(table);
+    this->accepting.swap(accepting);
+    this->start = start;
+    this->trim();
+}
+// send the states from which no accept state can be reached to the dead state, the states
+// that are left keep their order
+void CompiledDFA::trim() {
+    size_t count = this->accepting.size();
+    std::vector<std::vector<int> > predecessors(count);
+    for (size_t state = 1; state < count; state++) {
+        for (size_t c = 0; c < this->classes; c++) {
+            predecessors[this->table[state * this->classes + c]].push_back(state);
+        }
+    }
+    std::vector<bool> useful(count, false);
+    std::vector<int> queue;
+    for (size_t state = 1; state < count; state++) {
+        if (this->accepting[state]) {
+            useful[state] = true;
+            queue.push_back(state);
+        }
+    }
+    while (!queue.empty()) {
+        int state = queue.back();
+        queue.pop_back();
+        std::vector<int>::iterator it;
+        for (it = predecessors[state].begin(); it != predecessors[state].end(); it++) {
+            if (!useful[*it]) {
+                useful[*it] = true;
+                queue.push_back(*it);
+            }
+        }
+    }
+    std::vector<int> renumbered(count, 0);
+    int kept = 1;
+    for (size_t state = 1; state < count; state++) {
+        if (useful[state]) {
+            renumbered[state] = kept++;
+        }
+    }
+    std::vector<int> table(kept * this->classes, 0);
+    std::vector<bool> accepting(kept, false);
+    for (size_t state = 1; state < count; state++) {
+        if (!useful[state]) {
+            continue;
+        }
+        accepting[renumbered[state]] = this->accepting[state];
+        for (size_t c = 0; c < this->classes; c++) {
+            table[renumbered[state] * this->classes + c] = renumbered[this->table[state * this->classes + c]];
+        }
+    }
+    this->table.swap(table);
+    this->accepting.swap(accepting);
+    this->start = renumbered[this->start];
+}
+// subset construction over the states of this DFA, following the given successors per state
+// and class. with restart the start set is added after every step
+void CompiledDFA::determinize(const std::vector<std::vector<int> >& arrows, const std::vector<int>& startset,
+                              bool restart, const std::vector<bool>& accept, CompiledDFA& result) const {
+    std::map<std::vector<int>, int> ids;
+    std::vector<std::vector<int> > sets;
+    findSet(std::vector<int>(), ids, sets);
+    result.classOf = this->classOf;
+    result.classes = this->classes;
+    result.start = findSet(startset, ids, sets);
+    result.table.clear();
+    result.accepting.clear();
+    for (size_t id = 0; id < sets.size(); id++) {
+        bool accepts = false;
+        std::vector<int>::iterator member;
+        for (member = sets[id].begin(); member != sets[id].end(); member++) {
+            if (accept[*member]) {
+                accepts = true;
+            }
+        }
+        result.accepting.push_back(accepts);
+        for (size_t c = 0; c < this->classes; c++) {
+            if (id == 0 and !restart) {
+                result.table.push_back(0);
+                continue;
+            }
+            std::vector<int> targets;
+            if (restart) {
+                targets = startset;
+            }
+            for (member = sets[id].begin(); member != sets[id].end(); member++) {
+                const std::vector<int>& successors = arrows[*member * this->classes + c];
+                targets.insert(targets.end(), successors.begin(), successors.end());
+            }
+            // findSet may grow sets, which is why members are not iterated while it runs
+            result.table.push_back(findSet(targets, ids, sets));
+        }
+    }
+    result.trim();
+}
+// whether the whole string is accepted
+bool CompiledDFA::accepts(const std::string& text) const {
+    int state = this->start;
+    std::string::const_iterator it;
+    for (it = text.begin(); it != text.end() and state != 0; it++) {
+        state = this->next(state, *it);
+    }
+    return this->accepting[state];
+}
+// whether every key is accepted: each lane runs a key, and a lane whose key is done or whose
+// state is dead takes the next key, until no keys are left
+void CompiledDFA::acceptsBatch(const std::vector<std::string>& keys, std::vector<bool>& results) const {
+    results.assign(keys.size(), false);
+    size_t key[batchlanes];
+    size_t position[batchlanes];
+    int state[batchlanes];
+    size_t lanes = 0;
+    size_t nextkey = 0;
+    while (lanes < batchlanes and nextkey < keys.size()) {
+        key[lanes] = nextkey++;
+        position[lanes] = 0;
+        state[lanes] = this->start;
+        prefetch(keys[key[lanes]].data());
+        lanes++;
+    }
+    while (lanes > 0) {
+        size_t lane = 0;
+        while (lane < lanes) {
+            const std::string& text = keys[key[lane]];
+            if (position[lane] == text.size() or state[lane] == 0) {
+                results[key[lane]] = this->accepting[state[lane]];
+                if (nextkey < keys.size()) {
+                    key[lane] = nextkey++;
+                    position[lane] = 0;
+                    state[lane] = this->start;
+                    prefetch(keys[key[lane]].data());
+                    lane++;
+                }
+                else {
+                    // the last lane takes this one's place
+                    lanes--;
+                    key[lane] = key[lanes];
+                    position[lane] = position[lanes];
+                    state[lane] = state[lanes];
+                }
+                continue;
+            }
+            unsigned char byte = text[position[lane]++];
+            state[lane] = this->table[state[lane] * this->classes + this->classOf[byte]];
+            prefetch(&this->table[state[lane] * this->classes]);
+            lane++;
+        }
+    }
+}
+// the DFA for every string that ends with a string of the language
+void CompiledDFA::unanchored(CompiledDFA& result) const {
+    std::vector<std::vector<int> > arrows(this->table.size());
+    for (size_t i = 0; i < this->table.size(); i++) {
+        if (this->table[i] != 0) {
+            arrows[i].push_back(this->table[i]);
+        }
+    }
+    std::vector<int> startset;
+    if (this->start != 0) {
+        startset.push_back(this->start);
+    }
+    this->determinize(arrows, startset, true, this->accepting, result);
+}
+// the DFA for the reversal of every string that starts with a string of the language: the
+// arrows are turned around, the accept states become the start set and the start state the
+// only accept state
+void CompiledDFA::reversed(CompiledDFA& result) const {
+    std::vector<std::vector<int> > arrows(this->table.size());
+    for (size_t state = 1; state < this->accepting.size(); state++) {
+        for (size_t c = 0; c < this->classes; c++) {
+            int target = this->table[state * this->classes + c];
+            if (target != 0) {
+                arrows[target * this->classes + c].push_back(state);
+            }
+        }
+    }
+    std::vector<int> startset;
+    for (size_t state = 1; state < this->accepting.size(); state++) {
+        if (this->accepting[state]) {
+            startset.push_back(state);
+        }
+    }
+    std::vector<bool> accept(this->accepting.size(), false);
+    if (this->start != 0) {
+        accept[this->start] = true;
+    }
+    this->determinize(arrows, startset, true, accept, result);
+}
+// merge the states that accept the same strings (Moore's partition refinement): states are
+// split by their successor blocks until no block splits any more. the block of the dead state
+// becomes state 0, the others are numbered in the order of their first state
+void CompiledDFA::minimize() {
+    size_t count = this->accepting.size();
+    std::vector<int> block(count);
+    for (size_t state = 0; state < count; state++) {
+        block[state] = this->accepting[state] ? 1 : 0;
+    }
+    size_t blocks = std::set<int>(block.begin(), block.end()).size();
+    while (true) {
+        std::map<std::vector<int>, int> ids;
+        std::vector<int> refined(count);
+        std::vector<int> signature(this->classes + 1);
+        for (size_t state = 0; state < count; state++) {
+            signature[0] = block[state];
+            for (size_t c = 0; c < this->classes; c++) {
+                signature[c + 1] = block[this->table[state * this->classes + c]];
+            }
+            int id = ids.size();
+            refined[state] = ids.insert(std::make_pair(signature, id)).first->second;
+        }
+        block.swap(refined);
+        if (ids.size() == blocks) {
+            break;
+        }
+        blocks = ids.size();
+    }
+    std::vector<int> renumbered(blocks, -1);
+    std::vector<int> representative;
+    renumbered[block[0]] = 0;
+    representative.push_back(0);
+    for (size_t state = 1; state < count; state++) {
+        if (renumbered[block[state]] < 0) {
+            renumbered[block[state]] = representative.size();
+            representative.push_back(state);
+        }
+    }
+    std::vector<int> table(blocks * this->classes);
+    std::vector<bool> accepting(blocks);
+    for (size_t state = 0; state < blocks; state++) {
+        accepting[state] = this->accepting[representative[state]];
+        for (size_t c = 0; c < this->classes; c++) {
+            table[state * this->classes + c] = renumbered[block[this->table[representative[state] * this->classes + c]]];
+        }
+    }
+    this->table.swap(table);
+    this->accepting.swap(accepting);
+    this->start = renumbered[block[this->start]];
+}
+// run a text from the start state, counting the states entered and the arrows taken
+void CompiledDFA::profile(const char* text, size_t length, DFAProfile& profile) const {
+    if (profile.visits.size() != this->size() or profile.arrows.size() != this->table.size()) {
+        profile.visits.assign(this->size(), 0);
+        profile.arrows.assign(this->table.size(), 0);
+    }
+    int state = this->start;
+    profile.visits[state]++;
+    for (size_t i = 0; i < length and state != 0; i++) {
+        size_t arrow = state * this->classes + this->classOf[static_cast<unsigned char>(text[i])];
+        state = this->table[arrow];
+        profile.arrows[arrow]++;
+        profile.visits[state]++;
+    }
+}
+// orders states by descending visit count, ties by number
+struct HotterState {
+    const std::vector<size_t>* visits;
+    bool operator()(int first, int second) const {
+        if ((*this->visits)[first] != (*this->visits)[second]) {
+            return (*this->visits)[first] > (*this->visits)[second];
+        }
+        return first < second;
+    }
+};
+// renumber the states so the hot ones and their most used successors are together at the
+// front of the table (the greedy chaining of Pettis and Hansen, with states for blocks)
+size_t CompiledDFA::relayout(const DFAProfile& profile) {
+    size_t states = this->size();
+    if (profile.visits.size() != states or profile.arrows.size() != this->table.size()) {
+        std::cerr << "The profile does not belong to this DFA, keeping the layout." << std::endl;
+        return 0;
+    }
+    std::vector<int> hot;
+    for (size_t state = 1; state < states; state++) {
+        if (profile.visits[state] > 0) {
+            hot.push_back(state);
+        }
+    }
+    HotterState hotter;
+    hotter.visits = &profile.visits;
+    std::sort(hot.begin(), hot.end(), hotter);
+    // number of every old state, -1 while it has none
+    std::vector<int> number(states, -1);
+    std::vector<int> order(1, 0);
+    number[0] = 0;
+    std::vector<int>::iterator it;
+    for (it = hot.begin(); it != hot.end(); it++) {
+        int state = *it;
+        while (state > 0 and number[state] == -1) {
+            number[state] = order.size();
+            order.push_back(state);
+            // go on with the successor over the most used arrow that has no number yet
+            int next = 0;
+            size_t used = 0;
+            for (size_t c = 0; c < this->classes; c++) {
+                size_t arrow = state * this->classes + c;
+                int target = this->table[arrow];
+                if (number[target] == -1 and profile.arrows[arrow] > used) {
+                    next = target;
+                    used = profile.arrows[arrow];
+                }
+            }
+            state = next;
+        }
+    }
+    size_t hotstates = order.size();
+    for (size_t state = 1; state < states; state++) {
+        if (number[state] == -1) {
+            number[state] = order.size();
+            order.push_back(state);
+        }
+    }
+    std::vector<int> table(this->table.size());
+    std::vector<bool> accepting(states);
+    for (size_t i = 0; i < states; i++) {
+        int state = order[i];
+        for (size_t c = 0; c < this->classes; c++) {
+            table[i * this->classes + c] = number[this->table[state * this->classes + c]];
+        }
+        accepting[i] = this->accepting[state];
+    }
+    this->table.swap(table);
+    this->accepting.swap(accepting);
+    this->start = number[this->start];
+    return hotstates;
+}
+// return the start state
+int CompiledDFA::getStart() const {
+    return this->start;
+}
+// number of states, including the dead state
+size_t CompiledDFA::size() const {
+    return this->accepting.size();
+}
+// number of symbol classes, including class 0 for the bytes outside the alphabet
+size_t CompiledDFA::getClassCount() const {
+    return this->classes;
+}
+// return the symbol class of a byte
+int CompiledDFA::getSymbolClass(unsigned char byte) const {
+    return this->classOf[byte];
+}
+// the successor of a state for a symbol class
+int CompiledDFA::getTransition(int state, size_t symbolclass) const {
+    return this->table[state * this->classes + symbolclass];
+}
+// write the table to a file, false when that fails
+bool CompiledDFA::save(const std::string& filename) const {
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file == NULL) {
+        std::cerr << "Couldn't create '" << filename << "'." << std::endl;
+        return false;
+    }
+    uint64_t header[3] = {this->accepting.size(), this->classes, static_cast<uint64_t>(this->start)};
+    fwrite(compiledmagic, 1, 8, file);
+    fwrite(header, sizeof(uint64_t), 3, file);
+    for (int byte = 0; byte < 256; byte++) {
+        uint16_t symbolclass = this->classOf[byte];
+        fwrite(&symbolclass, sizeof(uint16_t), 1, file);
+    }
+    std::vector<uint32_t> row(this->classes);
+    for (size_t state = 0; state < this->accepting.size(); state++) {
+        char accept = this->accepting[state] ? 1 : 0;
+        for (size_t c = 0; c < this->classes; c++) {
+            row[c] = this->table[state * this->classes + c];
+        }
+        fwrite(&accept, 1, 1, file);
+        fwrite(row.data(), sizeof(uint32_t), this->classes, file);
+    }
+    bool failed = ferror(file);
+    if (fclose(file) != 0 or failed) {
+        std::cerr << "Writing '" << filename << "' failed." << std::endl;
+        return false;
+    }
+    return true;
+}
+// read a table written by save, then send the dead ends to the dead state (the out of core
+// determinizer doesn't do that)
+bool CompiledDFA::load(const std::string& filename) {
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == NULL) {
+        std::cerr << "Couldn't open '" << filename << "'." << std::endl;
+        return false;
+    }
+    char magic[8];
+    uint64_t header[3];
+    uint16_t classof[256];
+    bool valid = fread(magic, 1, 8, file) == 8 and memcmp(magic, compiledmagic, 8) == 0 and
+                 fread(header, sizeof(uint64_t), 3, file) == 3 and fread(classof, sizeof(uint16_t), 256, file) == 256;
+    // the table uses ints, and state 0 must exist
+    valid = valid and header[0] > 0 and header[0] <= 0x7FFFFFFF and header[1] > 0 and header[1] <= 256 and
+            header[2] < header[0] and header[0] * header[1] <= 0x7FFFFFFF;
+    for (int byte = 0; byte < 256 and valid; byte++) {
+        valid = classof[byte] < header[1];
+    }
+    std::vector<int> table;
+    std::vector<bool> accepting;
+    if (valid) {
+        table.resize(header[0] * header[1]);
+        accepting.resize(header[0]);
+    }
+    std::vector<uint32_t> row(valid ? header[1] : 0);
+    for (size_t state = 0; state < accepting.size() and valid; state++) {
+        char accept;
+        valid = fread(&accept, 1, 1, file) == 1 and fread(row.data(), sizeof(uint32_t), row.size(), file) == row.size();
+        accepting[state] = accept != 0;
+        for (size_t c = 0; c < row.size() and valid; c++) {
+            valid = row[c] < header[0];
+            table[state * row.size() + c] = row[c];
+        }
+    }
+    fclose(file);
+    if (!valid) {
+        std::cerr << "The file '" << filename << "' doesn't hold a compiled DFA." << std::endl;
+        return false;
+    }
+    this->classOf.assign(classof, classof + 256);
+    this->classes = header[1];
+    this->table.swap(table);
+    this->accepting.swap(accepting);
+    this->start = header[2];
+    this->trim();
+    return true;
+}
+
+// PREFILTER CLASS ///////////////////////////////////////////////////////////////
+
+Prefilter::Prefilter(): firstCount(256), useful(false) {
+    std::fill(this->firstBytes, this->firstBytes + 256, true);
+}
+Prefilter::Prefilter(const CompiledDFA& dfa): firstCount(0), useful(false) {
+    this->analyze(dfa);
+}
+// extract the literal prefix and the first bytes of the language of a DFA
+void Prefilter::analyze(const CompiledDFA& dfa) {
+    this->prefix.clear();
+    std::fill(this->firstBytes, this->firstBytes + 256, true);
+    this->firstCount = 256;
+    this->useful = false;
+    int state = dfa.getStart();
+    // with the empty string in the language a match starts at every offset
+    if (state == 0 or dfa.isAccepting(state)) {
+        return;
+    }
+    this->firstCount = 0;
+    for (int byte = 0; byte < 256; byte++) {
+        this->firstBytes[byte] = dfa.next(state, byte) != 0;
+        if (this->firstBytes[byte]) {
+            this->firstCount++;
+        }
+    }
+    // the prefix goes on as long as a single byte keeps the run alive
+    while (!dfa.isAccepting(state) and this->prefix.size() < maxprefix) {
+        int only = -1;
+        for (int byte = 0; byte < 256; byte++) {
+            if (dfa.next(state, byte) != 0) {
+                if (only != -1) {
+                    only = -2;
+                    break;
+                }
+                only = byte;
+            }
+        }
+        if (only < 0) {
+            break;
+        }
+        this->prefix += static_cast<char>(only);
+        state = dfa.next(state, only);
+    }
+    // testing a big set of first bytes costs about as much as a DFA step
+    this->useful = !this->prefix.empty() or this->firstCount <= 64;
+}
+// the first offset from the given one where a match can start, or the length if none
+size_t Prefilter::next(const char* text, size_t length, size_t from) const {
+    if (from >= length) {
+        return length;
+    }
+    const void* found;
+    if (this->prefix.size() > 1) {
+        found = memmem(text + from, length - from, this->prefix.data(), this->prefix.size());
+        return found == NULL ? length : static_cast<const char*>(found) - text;
+    }
+    if (this->prefix.size() == 1) {
+        found = memchr(text + from, this->prefix[0], length - from);
+        return found == NULL ? length : static_cast<const char*>(found) - text;
+    }
+    for (size_t i = from; i < length; i++) {
+        if (this->firstBytes[static_cast<unsigned char>(text[i])]) {
+            return i;
+        }
+    }
+    return length;
+}
+// whether skipping to candidates is worth it
+bool Prefilter::isUseful() const {
+    return this->useful;
+}
+// return the literal every match starts with
+std::string Prefilter::getPrefix() const {
+    return this->prefix;
+}
+// number of bytes a match can start with
+size_t Prefilter::getFirstCount() const {
+    return this->firstCount;
+}
+
+// SCANNER CLASS /////////////////////////////////////////////////////////////////
+
+Scanner::Scanner(const DFA& dfa): forward(dfa) {
+    this->forward.reversed(this->reverse);
+    this->prefilter.analyze(this->forward);
+}
+// return the prefilter the scanner skips with
+const Prefilter& Scanner::getPrefilter() const {
+    return this->prefilter;
+}
+// run the reverse DFA from the end of the buffer to the front. after reading the bytes from
+// offset i to the end, it accepts exactly when a match starts at offset i
+void Scanner::findStarts(const char* text, size_t length, std::vector<bool>& starts) const {
+    starts.assign(length + 1, false);
+    int state = this->reverse.getStart();
+    if (state == 0) {
+        return;
+    }
+    starts[length] = this->reverse.isAccepting(state);
+    for (size_t i = length; i > 0; i--) {
+        state = this->reverse.next(state, text[i - 1]);
+        starts[i - 1] = this->reverse.isAccepting(state);
+    }
+}
+// the end of the longest match starting at an offset, or -1 when none does. the run stops
+// early when it reaches an offset in a state an earlier run of the scan was in there, and
+// takes the furthest accept end that run found from it on
+size_t Scanner::longestEnd(const char* text, size_t length, size_t offset, ScanScratch& scratch) const {
+    const size_t none = static_cast<size_t>(-1);
+    std::vector<int>& path = scratch.path;
+    std::vector<int>& head = scratch.memohead;
+    std::vector<int>& states = scratch.memostate;
+    std::vector<size_t>& ends = scratch.memoend;
+    std::vector<int>& next = scratch.memonext;
+    // runs start in increasing order, so the records before the offset are never looked up
+    // again: once all runs so far died before it they are dropped
+    if (offset >= scratch.memobase + head.size()) {
+        scratch.memobase = offset;
+        head.clear();
+        states.clear();
+        ends.clear();
+        next.clear();
+    }
+    path.clear();
+    size_t end = none;
+    int state = this->forward.getStart();
+    for (size_t j = offset; state != 0; j++) {
+        size_t slot = j - scratch.memobase;
+        if (slot == head.size()) {
+            head.push_back(-1);
+        }
+        int record = head[slot];
+        while (record != -1 and states[record] != state) {
+            record = next[record];
+        }
+        if (record != -1) {
+            end = ends[record];
+            break;
+        }
+        path.push_back(state);
+        if (j == length) {
+            break;
+        }
+        state = this->forward.next(state, text[j]);
+    }
+    // record the furthest accept end from every offset of the run, from the back
+    for (size_t k = path.size(); k > 0; k--) {
+        size_t at = offset + k - 1;
+        if (end == none and this->forward.isAccepting(path[k - 1])) {
+            end = at;
+        }
+        states.push_back(path[k - 1]);
+        ends.push_back(end);
+        next.push_back(head[at - scratch.memobase]);
+        head[at - scratch.memobase] = states.size() - 1;
+    }
+    return end;
+}
+// leftmost longest matches, using the reverse pass
+void Scanner::scanLongest(const char* text, size_t length, std::vector<Match>& matches, ScanScratch& scratch) const {
+    std::vector<bool>& starts = scratch.starts;
+    this->findStarts(text, length, starts);
+    size_t i = 0;
+    while (i <= length) {
+        if (!starts[i]) {
+            i++;
+            continue;
+        }
+        // a match starts here, so the run finds an accept end
+        size_t end = this->longestEnd(text, length, i, scratch);
+        matches.push_back(Match(i, end));
+        i = end > i ? end : i + 1;
+    }
+}
+// leftmost longest matches, running the forward DFA from every candidate of the prefilter.
+// a useful prefilter means there are no empty matches
+void Scanner::scanCandidates(const char* text, size_t length, std::vector<Match>& matches, ScanScratch& scratch) const {
+    const size_t none = static_cast<size_t>(-1);
+    size_t i = this->prefilter.next(text, length, 0);
+    while (i < length) {
+        size_t end = this->longestEnd(text, length, i, scratch);
+        if (end != none and end > i) {
+            matches.push_back(Match(i, end));
+            i = end;
+        }
+        else {
+            i++;
+        }
+        i = this->prefilter.next(text, length, i);
+    }
+}
+// one match for every end offset. every live forward state remembers the leftmost start it
+// was reached from; two runs in the same state behave the same from then on, so only the
+// leftmost is kept
+void Scanner::scanEnds(const char* text, size_t length, std::vector<Match>& matches, ScanScratch& scratch) const {
+    // with a prefilter a run starts at every offset and offsets without live runs are
+    // skipped, otherwise runs only start where the reverse pass found a match start
+    std::vector<bool>& starts = scratch.starts;
+    bool skipping = this->prefilter.isUseful();
+    if (!skipping) {
+        this->findStarts(text, length, starts);
+    }
+    // the leftmost offsets are left empty after every scan, so they only need resizing
+    const size_t none = static_cast<size_t>(-1);
+    std::vector<size_t>& leftmost = scratch.leftmost;
+    std::vector<size_t>& nextleftmost = scratch.nextleftmost;
+    std::vector<int>& active = scratch.active;
+    std::vector<int>& nextactive = scratch.nextactive;
+    if (leftmost.size() != this->forward.size()) {
+        leftmost.assign(this->forward.size(), none);
+        nextleftmost.assign(this->forward.size(), none);
+    }
+    active.clear();
+    for (size_t i = 0; i <= length; i++) {
+        if (skipping and active.empty()) {
+            i = this->prefilter.next(text, length, i);
+            if (i == length) {
+                break;
+            }
+        }
+        int begin = this->forward.getStart();
+        if ((skipping or starts[i]) and begin != 0 and leftmost[begin] == none) {
+            leftmost[begin] = i;
+            active.push_back(begin);
+        }
+        size_t best = none;
+        std::vector<int>::iterator state;
+        for (state = active.begin(); state != active.end(); state++) {
+            if (this->forward.isAccepting(*state) and leftmost[*state] < best) {
+                best = leftmost[*state];
+            }
+        }
+        if (best != none) {
+            matches.push_back(Match(best, i));
+        }
+        if (i == length) {
+            break;
+        }
+        nextactive.clear();
+        for (state = active.begin(); state != active.end(); state++) {
+            int target = this->forward.next(*state, text[i]);
+            if (target != 0) {
+                if (nextleftmost[target] == none) {
+                    nextactive.push_back(target);
+                    nextleftmost[target] = leftmost[*state];
+                }
+                else if (leftmost[*state] < nextleftmost[target]) {
+                    nextleftmost[target] = leftmost[*state];
+                }
+            }
+            leftmost[*state] = none;
+        }
+        active.swap(nextactive);
+        leftmost.swap(nextleftmost);
+    }
+    std::vector<int>::iterator state;
+    for (state = active.begin(); state != active.end(); state++) {
+        leftmost[*state] = none;
+    }
+    active.clear();
+}
+// append the matches in a buffer to the given vector, ordered by end offset
+void Scanner::scan(const char* text, size_t length, std::vector<Match>& matches, MatchSemantics semantics) const {
+    ScanScratch scratch;
+    this->scan(text, length, matches, scratch, semantics);
+}
+// append the matches in a buffer to the given vector, working in the given scratch
+void Scanner::scan(const char* text, size_t length, std::vector<Match>& matches, ScanScratch& scratch,
+                   MatchSemantics semantics) const {
+    if (semantics == MATCH_ALL_ENDS) {
+        this->scanEnds(text, length, matches, scratch);
+        return;
+    }
+    // the records of the runs of an earlier scan don't hold for this text
+    scratch.memobase = 0;
+    scratch.memohead.clear();
+    if (this->prefilter.isUseful()) {
+        this->scanCandidates(text, length, matches, scratch);
+    }
+    else {
+        this->scanLongest(text, length, matches, scratch);
+    }
+}
+// return the matches in a string
+std::vector<Match> Scanner::findAll(const std::string& text, MatchSemantics semantics) const {
+    std::vector<Match> matches;
+    this->scan(text.data(), text.size(), matches, semantics);
+    return matches;
+}
@@ -0,0 +1,198 @@
+/* Searching text with a DFA.
+ * CompiledDFA turns a DFA into an integer table indexed by state and symbol class, with a
+ * byte to class map in front of it, so a step is two array lookups. State 0 is the dead
+ * state: bytes outside the alphabet and states from which no accept state can be reached
+ * all lead there, which lets a run stop as soon as a match has become impossible.
+ * Scanner finds every occurrence of the language inside a text, as if the pattern started
+ * with an implicit sigma*. A reverse DFA is run once from right to left to mark every offset
+ * where a match starts; match ends are then found with forward DFA runs, never backtracking.
+ * Neither class changes after it is built and neither logs while scanning, so one object can
+ * be shared by any number of threads, each passing its own ScanScratch.
+**/
+#ifndef MATCHER_H_
+#define MATCHER_H_
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "automata.h"
+
+// how Scanner reports matches:
+// MATCH_LEFTMOST_LONGEST gives non overlapping matches, each the longest one starting at the
+// leftmost offset where a match starts after the previous match.
+// MATCH_ALL_ENDS gives one match for every offset where a match ends, starting at the
+// leftmost offset of any match ending there (so matches may overlap).
+enum MatchSemantics {
+    MATCH_LEFTMOST_LONGEST,
+    MATCH_ALL_ENDS
+};
+
+// the first 8 bytes of a file written by CompiledDFA::save. after them come the number of
+// states, the number of classes and the start state as 64 bit numbers, the class of every
+// byte as 16 bit numbers, and per state a byte telling whether it accepts followed by its
+// successors as 32 bit numbers. numbers are in the byte order of the machine
+extern const char compiledmagic[9];
+
+// number of keys CompiledDFA::acceptsBatch runs side by side
+static const size_t batchlanes = 16;
+
+// start and end offset of a match, the end is one past the last byte
+typedef std::pair<size_t, size_t> Match;
+
+// how often the states and arrows of a CompiledDFA were used, gathered by its profile
+// method over a sample of the text it will run on
+struct DFAProfile {
+    // the number of times every state was entered
+    std::vector<size_t> visits;
+    // the number of times every arrow was taken, indexed like the table (state * classes + class)
+    std::vector<size_t> arrows;
+};
+
+class CompiledDFA {
+    private:
+        // symbol class of every byte, class 0 holds the bytes outside the alphabet
+        std::vector<int> classOf;
+        size_t classes;
+        // successor of every state for every class, state 0 is the dead state
+        std::vector<int> table;
+        std::vector<bool> accepting;
+        int start;
+        // send the states from which no accept state can be reached to the dead state
+        void trim();
+        // subset construction over the states of this DFA, following the given arrows
+        // (successors per state and class). with restart the start set is added after every
+        // step, which puts sigma* in front of the language
+        void determinize(const std::vector<std::vector<int> >&, const std::vector<int>&, bool,
+                         const std::vector<bool>&, CompiledDFA&) const;
+    public:
+        CompiledDFA();
+        explicit CompiledDFA(const DFA&);
+        // build the table for a DFA, missing transitions lead to the dead state
+        void compile(const DFA&);
+        // take over a table built elsewhere: the class of every byte, the number of classes,
+        // the successors per state and class and the accept states (these two are swapped
+        // in) and the start state. state 0 must lead to itself
+        void setTable(const std::vector<int>&, size_t, std::vector<int>&, std::vector<bool>&, int);
+        // whether the whole string is accepted
+        bool accepts(const std::string&) const;
+        // whether every key is accepted, into results. the keys are run batchlanes at a time,
+        // a byte of each in turn, and the row every step lands in is prefetched: the cache
+        // misses of one key overlap with the steps of the others instead of following each
+        // other, which pays off once the table is larger than the cache
+        void acceptsBatch(const std::vector<std::string>&, std::vector<bool>&) const;
+        // the DFA for every string that ends with a string of the language
+        void unanchored(CompiledDFA&) const;
+        // the DFA for the reversal of every string that starts with a string of the language
+        void reversed(CompiledDFA&) const;
+        // merge the states that accept the same strings, the dead state stays state 0
+        void minimize();
+        // run a text from the start state like accepts does, counting every state entered and
+        // every arrow taken. the profile is cleared first when it belongs to another table
+        void profile(const char*, size_t, DFAProfile&) const;
+        // renumber the states for the profile: the states that were visited come first, the
+        // hottest first, each followed by the chain of its most used successors, so the rows
+        // a run goes through are close together in memory. the cold states follow in their
+        // old order. returns the number of hot states, counting the dead state, which stays 0.
+        // save keeps the order, so a table laid out once loads laid out
+        size_t relayout(const DFAProfile&);
+        int next(int, unsigned char) const;
+        bool isAccepting(int) const;
+        int getStart() const;
+        // number of states, including the dead state
+        size_t size() const;
+        // number of symbol classes, including class 0 for the bytes outside the alphabet
+        size_t getClassCount() const;
+        int getSymbolClass(unsigned char) const;
+        // the successor of a state for a symbol class
+        int getTransition(int, size_t) const;
+        // write the table to a file, false when that fails
+        bool save(const std::string&) const;
+        // read a table written by save (or OutOfCoreDeterminizer), false when the file is
+        // missing or broken
+        bool load(const std::string&);
+};
+
+// the successor of a state for a byte
+inline int CompiledDFA::next(int state, unsigned char byte) const {
+    return this->table[state * this->classes + this->classOf[byte]];
+}
+// whether a state is an accept state
+inline bool CompiledDFA::isAccepting(int state) const {
+    return this->accepting[state];
+}
+
+// candidate offsets for a search, found without running the DFA: a literal every match
+// starts with, or else the set of bytes a match can start with. when the language has the
+// empty string there is nothing to skip and the prefilter is not useful.
+class Prefilter {
+    private:
+        std::string prefix;
+        bool firstBytes[256];
+        size_t firstCount;
+        bool useful;
+    public:
+        Prefilter();
+        explicit Prefilter(const CompiledDFA&);
+        // extract the literal prefix and the first bytes of the language of a DFA
+        void analyze(const CompiledDFA&);
+        // the first offset from the given one where a match can start, or the length if none
+        size_t next(const char*, size_t, size_t) const;
+        // whether skipping to candidates is worth it
+        bool isUseful() const;
+        std::string getPrefix() const;
+        // number of bytes a match can start with
+        size_t getFirstCount() const;
+};
+
+// buffers a scan works in, reused between scans. a scratch belongs to one thread at a time
+struct ScanScratch {
+    std::vector<bool> starts;
+    std::vector<size_t> leftmost;
+    std::vector<size_t> nextleftmost;
+    std::vector<int> active;
+    std::vector<int> nextactive;
+    // the states of the current leftmost longest run, and the records earlier runs of the
+    // scan left behind: per offset from memobase the first record, and per record a state,
+    // the furthest accept end from there (-1 for none) and the next record at that offset
+    std::vector<int> path;
+    size_t memobase;
+    std::vector<int> memohead;
+    std::vector<int> memostate;
+    std::vector<size_t> memoend;
+    std::vector<int> memonext;
+};
+
+// finds all occurrences of a language in a text. every pass over the text is linear. for
+// MATCH_LEFTMOST_LONGEST the forward run of a match goes on until the DFA dies, which can be
+// past the end of the match. the next run stops as soon as it is in a state an earlier run
+// was in at the same offset, so no (offset, state) pair is stepped through twice in a scan.
+// with a useful prefilter the scanner jumps from candidate to candidate with memmem/memchr
+// and runs the forward DFA only from there, without the reverse pass. runs from candidates
+// share the records of earlier runs the same way, so they stay linear too.
+class Scanner {
+    private:
+        CompiledDFA forward;
+        CompiledDFA reverse;
+        Prefilter prefilter;
+        // mark every offset (up to and including the length) where a match starts
+        void findStarts(const char*, size_t, std::vector<bool>&) const;
+        // the end of the longest match starting at an offset, or -1 when none does
+        size_t longestEnd(const char*, size_t, size_t, ScanScratch&) const;
+        // leftmost longest matches, using the reverse pass
+        void scanLongest(const char*, size_t, std::vector<Match>&, ScanScratch&) const;
+        // leftmost longest matches, running the forward DFA from the prefilter candidates
+        void scanCandidates(const char*, size_t, std::vector<Match>&, ScanScratch&) const;
+        // matches for every end offset
+        void scanEnds(const char*, size_t, std::vector<Match>&, ScanScratch&) const;
+    public:
+        explicit Scanner(const DFA&);
+        const Prefilter& getPrefilter() const;
+        // append the matches in a buffer to the given vector, ordered by end offset
+        void scan(const char*, size_t, std::vector<Match>&, MatchSemantics = MATCH_LEFTMOST_LONGEST) const;
+        // the same, working in the given scratch instead of allocating buffers
+        void scan(const char*, size_t, std::vector<Match>&, ScanScratch&, MatchSemantics = MATCH_LEFTMOST_LONGEST) const;
+        // return the matches in a string
+        std::vector<Match> findAll(const std::string&, MatchSemantics = MATCH_LEFTMOST_LONGEST) const;
+};
+
+#endif
@@ -0,0 +1,68 @@
+/* Running a loop over a range of indices on several threads.
+ * parallelFor cuts the range into chunks that the threads take from a shared atomic counter,
+ * so threads that get cheap chunks take more of them. The calling thread is one of the
+ * workers, and small ranges run on it alone, without starting threads. The body gets a chunk
+ * and the number of the worker running it (below the thread count), which it can use to pick
+ * scratch space of its own.
+**/
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+
+// indices a worker handles at least before taking the next chunk, unless told otherwise
+static const size_t parallelgrain = 64;
+
+// the number of threads to use when asked for 0
+inline size_t defaultThreadCount() {
+    size_t threads = std::thread::hardware_concurrency();
+    return threads == 0 ? 1 : threads;
+}
+
+// take chunks from the shared counter until the range is used up
+template <typename Body>
+void parallelWorker(const Body& body, size_t count, size_t chunk, std::atomic<size_t>* next, size_t worker) {
+    while (true) {
+        size_t begin = next->fetch_add(chunk);
+        if (begin >= count) {
+            break;
+        }
+        body(begin, std::min(begin + chunk, count), worker);
+    }
+}
+
+// call body(begin, end, worker) for chunks covering 0 up to count, on up to the given number
+// of threads (0 for one per core). chunks are at least grain long, a grain of 1 suits bodies
+// that take long per index. returns when every chunk is done
+template <typename Body>
+void parallelFor(size_t count, size_t threads, const Body& body, size_t grain = parallelgrain) {
+    if (threads == 0) {
+        threads = defaultThreadCount();
+    }
+    grain = std::max(grain, static_cast<size_t>(1));
+    threads = std::min(threads, (count + grain - 1) / grain);
+    if (threads <= 1) {
+        if (count > 0) {
+            body(0, count, 0);
+        }
+        return;
+    }
+    // several chunks per thread even out chunks of different cost
+    size_t chunk = std::max(grain, count / (8 * threads));
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (size_t worker = 1; worker < threads; worker++) {
+        workers.push_back(std::thread(parallelWorker<Body>, std::cref(body), count, chunk, &next, worker));
+    }
+    parallelWorker(body, count, chunk, &next, 0);
+    std::vector<std::thread>::iterator it;
+    for (it = workers.begin(); it != workers.end(); it++) {
+        it->join();
+    }
+}
+
+#endif
@@ -0,0 +1,267 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include "pikevm.h"
+
+// SPARSESET CLASS ///////////////////////////////////////////////////////////////
+
+SparseSet::SparseSet(): count(0) {
+}
+// make room for members below the given bound
+void SparseSet::resize(size_t bound) {
+    this->dense.assign(bound, 0);
+    this->sparse.assign(bound, 0);
+    this->count = 0;
+}
+// empty the set, without touching its members
+void SparseSet::clear() {
+    this->count = 0;
+}
+// the bound the set has room for
+size_t SparseSet::capacity() const {
+    return this->dense.size();
+}
+// number of members
+size_t SparseSet::size() const {
+    return this->count;
+}
+// the first member
+const int* SparseSet::begin() const {
+    return this->dense.empty() ? NULL : &this->dense[0];
+}
+// one past the last member
+const int* SparseSet::end() const {
+    return this->begin() + this->count;
+}
+
+// PIKEVM CLASS //////////////////////////////////////////////////////////////////
+
+PikeVM::PikeVM(): classOf(256, 0), classes(1), states(0), firstArrow(1, 0), firstEpsilon(1, 0), start(-1) {
+}
+PikeVM::PikeVM(const NFA& nfa) {
+    this->compile(nfa);
+}
+PikeVM::PikeVM(const ENFA& enfa) {
+    this->compile(enfa);
+}
+// number the states and arrows of an NFA, it has no epsilon arrows
+void PikeVM::compile(const NFA& nfa) {
+    this->build(nfa, false);
+}
+// number the states and arrows of an ENFA
+void PikeVM::compile(const ENFA& enfa) {
+    this->build(enfa, true);
+}
+// number the states, split the bytes into classes that every arrow treats the same, and lay
+// out the targets per state and class and the epsilon targets per state
+void PikeVM::build(const Automaton& automaton, bool withepsilon) {
+    std::vector<std::string> names = automaton.getStates();
+    std::map<std::string, int> index;
+    for (size_t i = 0; i < names.size(); i++) {
+        index.insert(std::make_pair(names[i], i));
+    }
+    this->states = names.size();
+    // every arrow as (state, target) with its label as a byte range, epsilon arrows apart
+    std::vector<std::pair<int, int> > labelled;
+    std::vector<SymbolRange> labels;
+    std::vector<std::pair<int, int> > epsilonarrows;
+    std::multimap<std::pair<std::string, char>, std::string> transitions = automaton.getTransitionFunction();
+    std::multimap<std::pair<std::string, char>, std::string>::iterator it;
+    for (it = transitions.begin(); it != transitions.end(); it++) {
+        std::map<std::string, int>::iterator from = index.find(it->first.first);
+        std::map<std::string, int>::iterator to = index.find(it->second);
+        if (from == index.end() or to == index.end()) {
+            continue;
+        }
+        if (withepsilon and it->first.second == epsilon) {
+            epsilonarrows.push_back(std::make_pair(from->second, to->second));
+        }
+        else {
+            labelled.push_back(std::make_pair(from->second, to->second));
+            labels.push_back(SymbolRange(it->first.second, it->first.second));
+        }
+    }
+    std::multimap<std::pair<std::string, SymbolRange>, std::string> ranges = automaton.getRangeTransitionFunction();
+    std::multimap<std::pair<std::string, SymbolRange>, std::string>::iterator range;
+    for (range = ranges.begin(); range != ranges.end(); range++) {
+        std::map<std::string, int>::iterator from = index.find(range->first.first);
+        std::map<std::string, int>::iterator to = index.find(range->second);
+        if (from != index.end() and to != index.end()) {
+            labelled.push_back(std::make_pair(from->second, to->second));
+            labels.push_back(range->first.second);
+        }
+    }
+    // bytes that are on exactly the same arrows share a class, bytes on none get class 0
+    std::vector<std::vector<int> > arrowsof(256);
+    for (size_t i = 0; i < labels.size(); i++) {
+        int last = static_cast<unsigned char>(labels[i].second);
+        for (int byte = static_cast<unsigned char>(labels[i].first); byte <= last; byte++) {
+            arrowsof[byte].push_back(i);
+        }
+    }
+    std::map<std::vector<int>, int> classids;
+    classids.insert(std::make_pair(std::vector<int>(), 0));
+    this->classOf.assign(256, 0);
+    for (int byte = 0; byte < 256; byte++) {
+        std::map<std::vector<int>, int>::iterator found = classids.find(arrowsof[byte]);
+        if (found == classids.end()) {
+            found = classids.insert(std::make_pair(arrowsof[byte], classids.size())).first;
+        }
+        this->classOf[byte] = found->second;
+    }
+    this->classes = classids.size();
+    // (state * classes + class, target) for every arrow and class it is on, sorted into rows
+    std::vector<std::pair<size_t, int> > slots;
+    std::vector<bool> seen(this->classes);
+    for (size_t i = 0; i < labels.size(); i++) {
+        seen.assign(this->classes, false);
+        int last = static_cast<unsigned char>(labels[i].second);
+        for (int byte = static_cast<unsigned char>(labels[i].first); byte <= last; byte++) {
+            int c = this->classOf[byte];
+            if (!seen[c]) {
+                seen[c] = true;
+                slots.push_back(std::make_pair(labelled[i].first * this->classes + c, labelled[i].second));
+            }
+        }
+    }
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+    this->firstArrow.assign(this->states * this->classes + 1, 0);
+    this->arrows.clear();
+    std::vector<std::pair<size_t, int> >::iterator slot = slots.begin();
+    for (size_t row = 0; row < this->states * this->classes; row++) {
+        while (slot != slots.end() and slot->first == row) {
+            this->arrows.push_back(slot->second);
+            slot++;
+        }
+        this->firstArrow[row + 1] = this->arrows.size();
+    }
+    std::sort(epsilonarrows.begin(), epsilonarrows.end());
+    epsilonarrows.erase(std::unique(epsilonarrows.begin(), epsilonarrows.end()), epsilonarrows.end());
+    this->firstEpsilon.assign(this->states + 1, 0);
+    this->epsilons.clear();
+    std::vector<std::pair<int, int> >::iterator arrow = epsilonarrows.begin();
+    for (size_t state = 0; state < this->states; state++) {
+        while (arrow != epsilonarrows.end() and arrow->first == static_cast<int>(state)) {
+            this->epsilons.push_back(arrow->second);
+            arrow++;
+        }
+        this->firstEpsilon[state + 1] = this->epsilons.size();
+    }
+    this->accepting.assign(this->states, false);
+    std::vector<std::string> accepts = automaton.getAcceptStates();
+    std::vector<std::string>::iterator name;
+    for (name = accepts.begin(); name != accepts.end(); name++) {
+        std::map<std::string, int>::iterator found = index.find(*name);
+        if (found != index.end()) {
+            this->accepting[found->second] = true;
+        }
+    }
+    std::map<std::string, int>::iterator found = index.find(automaton.getStartState());
+    this->start = found == index.end() ? -1 : found->second;
+}
+// add a state to a set and follow the epsilon arrows of every state that is new, depth first
+// from the stack
+bool PikeVM::add(int state, SparseSet& set, std::vector<int>& stack) const {
+    bool accepted = false;
+    stack.push_back(state);
+    while (!stack.empty()) {
+        int top = stack.back();
+        stack.pop_back();
+        if (!set.insert(top)) {
+            continue;
+        }
+        accepted = accepted or this->accepting[top];
+        for (size_t i = this->firstEpsilon[top]; i < this->firstEpsilon[top + 1]; i++) {
+            if (!set.contains(this->epsilons[i])) {
+                stack.push_back(this->epsilons[i]);
+            }
+        }
+    }
+    return accepted;
+}
+// size the sets of a scratch for this automaton and empty them. the stack holds at most the
+// epsilon arrows of the states in a set, plus one
+void PikeVM::prepare(PikeScratch& scratch) const {
+    if (scratch.current.capacity() != this->states or scratch.next.capacity() != this->states) {
+        scratch.current.resize(this->states);
+        scratch.next.resize(this->states);
+    }
+    scratch.current.clear();
+    scratch.next.clear();
+    scratch.stack.clear();
+    scratch.stack.reserve(this->epsilons.size() + 1);
+}
+// whether the whole text is accepted: the active states take one step per byte
+bool PikeVM::accepts(const char* text, size_t length, PikeScratch& scratch) const {
+    if (this->start < 0) {
+        return false;
+    }
+    this->prepare(scratch);
+    bool accepted = this->add(this->start, scratch.current, scratch.stack);
+    for (size_t i = 0; i < length; i++) {
+        size_t c = this->classOf[static_cast<unsigned char>(text[i])];
+        scratch.next.clear();
+        accepted = false;
+        const int* state;
+        for (state = scratch.current.begin(); state != scratch.current.end(); state++) {
+            size_t row = *state * this->classes + c;
+            for (size_t a = this->firstArrow[row]; a < this->firstArrow[row + 1]; a++) {
+                if (this->add(this->arrows[a], scratch.next, scratch.stack)) {
+                    accepted = true;
+                }
+            }
+        }
+        std::swap(scratch.current, scratch.next);
+        if (scratch.current.size() == 0) {
+            return false;
+        }
+    }
+    return accepted;
+}
+bool PikeVM::accepts(const std::string& text) const {
+    PikeScratch scratch;
+    return this->accepts(text.data(), text.size(), scratch);
+}
+// whether some substring is accepted: the start state joins the active states before every
+// byte, and the run stops at the first accept state it reaches
+bool PikeVM::contains(const char* text, size_t length, PikeScratch& scratch) const {
+    if (this->start < 0) {
+        return false;
+    }
+    this->prepare(scratch);
+    if (this->add(this->start, scratch.current, scratch.stack)) {
+        return true;
+    }
+    for (size_t i = 0; i < length; i++) {
+        size_t c = this->classOf[static_cast<unsigned char>(text[i])];
+        scratch.next.clear();
+        const int* state;
+        for (state = scratch.current.begin(); state != scratch.current.end(); state++) {
+            size_t row = *state * this->classes + c;
+            for (size_t a = this->firstArrow[row]; a < this->firstArrow[row + 1]; a++) {
+                if (this->add(this->arrows[a], scratch.next, scratch.stack)) {
+                    return true;
+                }
+            }
+        }
+        if (this->add(this->start, scratch.next, scratch.stack)) {
+            return true;
+        }
+        std::swap(scratch.current, scratch.next);
+    }
+    return false;
+}
+bool PikeVM::contains(const std::string& text) const {
+    PikeScratch scratch;
+    return this->contains(text.data(), text.size(), scratch);
+}
+// number of states
+size_t PikeVM::size() const {
+    return this->states;
+}
+// number of symbol classes, including class 0 for the bytes without arrows
+size_t PikeVM::getClassCount() const {
+    return this->classes;
+}
@@ -0,0 +1,103 @@
+/* Running large NFAs and ENFAs without building a DFA.
+ * PikeVM numbers the states of an automaton and keeps its arrows as integers: per state and
+ * symbol class the targets of the arrows on that class, and per state the targets of its
+ * epsilon arrows. A run keeps the set of active states (Thompson's simulation, as in Pike's
+ * VM) in a sparse set (Briggs and Torczon): membership, insertion and clearing are constant
+ * time, and walking the set only visits its members. Epsilon arrows are followed from an
+ * explicit stack as states are added, so every step costs time in the number of active
+ * states and their arrows, never in the size of the automaton, and nothing is allocated once
+ * the scratch space has been sized for the automaton.
+**/
+#ifndef PIKEVM_H_
+#define PIKEVM_H_
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "automata.h"
+
+// a set of integers below a fixed bound. dense holds the members in order of insertion and
+// sparse the position of every member in dense, which is only trusted when dense agrees
+class SparseSet {
+    private:
+        std::vector<int> dense;
+        std::vector<int> sparse;
+        size_t count;
+    public:
+        SparseSet();
+        // make room for members below the given bound, emptying the set
+        void resize(size_t);
+        // add a member, false when it was there already
+        bool insert(int);
+        bool contains(int) const;
+        void clear();
+        size_t size() const;
+        size_t capacity() const;
+        // the members, in order of insertion
+        const int* begin() const;
+        const int* end() const;
+};
+
+inline bool SparseSet::contains(int member) const {
+    size_t position = this->sparse[member];
+    return position < this->count and this->dense[position] == member;
+}
+inline bool SparseSet::insert(int member) {
+    if (this->contains(member)) {
+        return false;
+    }
+    this->sparse[member] = this->count;
+    this->dense[this->count] = member;
+    this->count++;
+    return true;
+}
+
+// the state sets and epsilon stack of a run, reused between runs. a scratch belongs to one
+// thread at a time
+struct PikeScratch {
+    SparseSet current;
+    SparseSet next;
+    std::vector<int> stack;
+};
+
+class PikeVM {
+    private:
+        std::vector<int> classOf;
+        size_t classes;
+        size_t states;
+        // the targets of state s on class c are arrows[firstArrow[s * classes + c]] up to
+        // arrows[firstArrow[s * classes + c + 1]]
+        std::vector<size_t> firstArrow;
+        std::vector<int> arrows;
+        // the same for the epsilon arrows of state s
+        std::vector<size_t> firstEpsilon;
+        std::vector<int> epsilons;
+        std::vector<bool> accepting;
+        int start;
+        // number the states and arrows, with epsilon arrows or without (symbol '\0' is then
+        // an ordinary byte)
+        void build(const Automaton&, bool);
+        // add a state and everything it reaches through epsilon arrows to a set, returns
+        // whether an accept state was added
+        bool add(int, SparseSet&, std::vector<int>&) const;
+        // size the scratch for this automaton
+        void prepare(PikeScratch&) const;
+    public:
+        PikeVM();
+        explicit PikeVM(const NFA&);
+        explicit PikeVM(const ENFA&);
+        void compile(const NFA&);
+        void compile(const ENFA&);
+        // whether the whole text is accepted
+        bool accepts(const char*, size_t, PikeScratch&) const;
+        bool accepts(const std::string&) const;
+        // whether some substring of the text is accepted
+        bool contains(const char*, size_t, PikeScratch&) const;
+        bool contains(const std::string&) const;
+        // number of states
+        size_t size() const;
+        // number of symbol classes, including class 0 for the bytes without arrows
+        size_t getClassCount() const;
+};
+
+#endif
@@ -0,0 +1,697 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <cctype>
+#include <iterator>
+#include "regexengine.h"
+
+// HELPER FUNCTIONS //////////////////////////////////////////////////////////////
+
+// write a symbol so it reads back as the same symbol
+static std::string regexSymbol(char symbol) {
+    unsigned char value = symbol;
+    if (symbol == '+' or symbol == '*' or symbol == '(' or symbol == ')' or symbol == legacyepsilon or
+        symbol == ' ' or symbol == '\\' or symbol == '{' or symbol == '}') {
+        return std::string("\\") + symbol;
+    }
+    if (value < 0x20 or value > 0x7E) {
+        return symbolToString(symbol);
+    }
+    return std::string(1, symbol);
+}
+
+RegexNode::RegexNode(RegexKind kind, char symbol, int left, int right):
+    kind(kind), symbol(symbol), left(left), right(right) {
+}
+
+// REGEXTREE CLASS ///////////////////////////////////////////////////////////////
+
+RegexTree::RegexTree(): pos(0), failed(false), captures(false), groups(0), root(-1) {
+    this->root = this->add(REGEX_EMPTY, 0, -1, -1);
+}
+RegexTree::RegexTree(const std::string& text): pos(0), failed(false), captures(false), groups(0), root(-1) {
+    this->parse(text);
+}
+int RegexTree::add(RegexKind kind, char symbol, int left, int right) {
+    this->nodes.push_back(RegexNode(kind, symbol, left, right));
+    return this->nodes.size() - 1;
+}
+// parse the text, returns false (leaving the empty language) on a syntax error
+bool RegexTree::parse(const std::string& text, bool captures) {
+    this->text = text;
+    this->pos = 0;
+    this->failed = false;
+    this->captures = captures;
+    this->groups = 0;
+    this->nodes.clear();
+    this->root = this->parseUnion();
+    if (!this->failed and this->pos < this->text.length()) {
+        std::cerr << "Unexpected '" << this->text[this->pos] << "' at position " << this->pos <<
+                     " in regex " << text << std::endl;
+        this->failed = true;
+    }
+    if (this->failed) {
+        this->nodes.clear();
+        this->groups = 0;
+        this->root = this->add(REGEX_EMPTY, 0, -1, -1);
+        return false;
+    }
+    return true;
+}
+// number of capture groups
+int RegexTree::getGroupCount() const {
+    return this->groups;
+}
+// union := concatenation ('+' concatenation)*
+int RegexTree::parseUnion() {
+    int left = this->parseConcatenation();
+    while (!this->failed and this->pos < this->text.length() and this->text[this->pos] == '+') {
+        this->pos++;
+        int right = this->parseConcatenation();
+        left = this->add(REGEX_UNION, 0, left, right);
+    }
+    return left;
+}
+// concatenation := star*, where nothing at all is epsilon
+int RegexTree::parseConcatenation() {
+    int result = -1;
+    while (!this->failed and this->pos < this->text.length() and this->text[this->pos] != '+' and
+           this->text[this->pos] != ')' and !(this->captures and this->text[this->pos] == '}')) {
+        int next = this->parseStar();
+        result = result < 0 ? next : this->add(REGEX_CONCAT, 0, result, next);
+    }
+    if (result < 0) {
+        result = this->add(REGEX_EPSILON, 0, -1, -1);
+    }
+    return result;
+}
+// star := atom '*'*
+int RegexTree::parseStar() {
+    int atom = this->parseAtom();
+    while (!this->failed and this->pos < this->text.length() and this->text[this->pos] == '*') {
+        this->pos++;
+        atom = this->add(REGEX_STAR, 0, atom, -1);
+    }
+    return atom;
+}
+// atom := '(' union ')' | '{' union '}' | 'E' | ' ' | '\' escaped symbol | symbol
+int RegexTree::parseAtom() {
+    char ch = this->text[this->pos++];
+    if (ch == '{' and this->captures) {
+        // groups are numbered before their inner groups
+        int group = ++this->groups;
+        int inner = this->parseUnion();
+        if (this->pos >= this->text.length() or this->text[this->pos] != '}') {
+            std::cerr << "Missing '}' in regex " << this->text << std::endl;
+            this->failed = true;
+            return inner;
+        }
+        this->pos++;
+        return this->add(REGEX_GROUP, 0, inner, group);
+    }
+    if (ch == '(') {
+        int inner = this->parseUnion();
+        if (this->pos >= this->text.length() or this->text[this->pos] != ')') {
+            std::cerr << "Missing ')' in regex " << this->text << std::endl;
+            this->failed = true;
+            return inner;
+        }
+        this->pos++;
+        return inner;
+    }
+    if (ch == '*') {
+        std::cerr << "Star without operand at position " << this->pos - 1 << " in regex " << this->text << std::endl;
+        this->failed = true;
+        return -1;
+    }
+    if (ch == legacyepsilon) {
+        return this->add(REGEX_EPSILON, 0, -1, -1);
+    }
+    if (ch == ' ') {
+        return this->add(REGEX_EMPTY, 0, -1, -1);
+    }
+    if (ch == '\\' and this->pos < this->text.length()) {
+        ch = this->text[this->pos++];
+        if (ch == 'x' and this->pos + 1 < this->text.length() and
+            isxdigit((unsigned char)this->text[this->pos]) and isxdigit((unsigned char)this->text[this->pos + 1])) {
+            ch = (char)strtol(this->text.substr(this->pos, 2).c_str(), NULL, 16);
+            this->pos += 2;
+        }
+    }
+    return this->add(REGEX_SYMBOL, ch, -1, -1);
+}
+// the symbols occurring in the regex, in order of appearance
+std::vector<char> RegexTree::getSymbols() const {
+    std::vector<char> symbols;
+    std::vector<RegexNode>::const_iterator it;
+    for (it = this->nodes.begin(); it != this->nodes.end(); it++) {
+        if (it->kind == REGEX_SYMBOL and find(symbols.begin(), symbols.end(), it->symbol) == symbols.end()) {
+            symbols.push_back(it->symbol);
+        }
+    }
+    return symbols;
+}
+// write a subtree back in regex syntax, with only the parentheses precedence requires
+std::string RegexTree::toString(int node) const {
+    const RegexNode& n = this->nodes[node];
+    switch (n.kind) {
+        case REGEX_EMPTY:
+            return " ";
+        case REGEX_EPSILON:
+            return std::string(1, legacyepsilon);
+        case REGEX_SYMBOL:
+            return regexSymbol(n.symbol);
+        case REGEX_UNION:
+            return this->toString(n.left) + "+" + this->toString(n.right);
+        case REGEX_CONCAT: {
+            std::string left = this->toString(n.left);
+            std::string right = this->toString(n.right);
+            if (this->nodes[n.left].kind == REGEX_UNION) {
+                left = "(" + left + ")";
+            }
+            if (this->nodes[n.right].kind == REGEX_UNION) {
+                right = "(" + right + ")";
+            }
+            return left + right;
+        }
+        case REGEX_STAR: {
+            std::string inner = this->toString(n.left);
+            RegexKind kind = this->nodes[n.left].kind;
+            if (kind == REGEX_UNION or kind == REGEX_CONCAT) {
+                inner = "(" + inner + ")";
+            }
+            return inner + "*";
+        }
+        case REGEX_GROUP:
+            return "{" + this->toString(n.left) + "}";
+    }
+    return "";
+}
+std::string RegexTree::toString() const {
+    return this->toString(this->root);
+}
+
+// append the positions of the second vector to the first, keeping it sorted and unique
+static void mergePositions(std::vector<int>& positions, const std::vector<int>& other) {
+    std::vector<int> merged;
+    std::set_union(positions.begin(), positions.end(), other.begin(), other.end(), std::back_inserter(merged));
+    positions.swap(merged);
+}
+// nullable, first and last positions of a subtree:
+// first(r+s) = first(r) + first(s), first(rs) = first(r) (+ first(s) if r is nullable),
+// last(rs) = last(s) (+ last(r) if s is nullable). concatenation and star add
+// follow(last(r)) += first(s) and follow(last(r)) += first(r) respectively
+bool RegexTree::positions(int node, const std::vector<int>& position, std::vector<int>& first,
+                          std::vector<int>& last, std::vector<std::vector<int> >& follow) const {
+    const RegexNode& n = this->nodes[node];
+    first.clear();
+    last.clear();
+    switch (n.kind) {
+        case REGEX_EMPTY:
+            return false;
+        case REGEX_EPSILON:
+            return true;
+        case REGEX_SYMBOL:
+            first.push_back(position[node]);
+            last.push_back(position[node]);
+            return false;
+        case REGEX_UNION: {
+            std::vector<int> rightfirst, rightlast;
+            bool nullable = this->positions(n.left, position, first, last, follow);
+            nullable = this->positions(n.right, position, rightfirst, rightlast, follow) or nullable;
+            mergePositions(first, rightfirst);
+            mergePositions(last, rightlast);
+            return nullable;
+        }
+        case REGEX_CONCAT: {
+            std::vector<int> leftfirst, leftlast, rightfirst, rightlast;
+            bool leftnullable = this->positions(n.left, position, leftfirst, leftlast, follow);
+            bool rightnullable = this->positions(n.right, position, rightfirst, rightlast, follow);
+            std::vector<int>::iterator it;
+            for (it = leftlast.begin(); it != leftlast.end(); it++) {
+                mergePositions(follow[*it], rightfirst);
+            }
+            first = leftfirst;
+            if (leftnullable) {
+                mergePositions(first, rightfirst);
+            }
+            last = rightlast;
+            if (rightnullable) {
+                mergePositions(last, leftlast);
+            }
+            return leftnullable and rightnullable;
+        }
+        case REGEX_STAR: {
+            this->positions(n.left, position, first, last, follow);
+            std::vector<int>::iterator it;
+            for (it = last.begin(); it != last.end(); it++) {
+                mergePositions(follow[*it], first);
+            }
+            return true;
+        }
+        case REGEX_GROUP:
+            return this->positions(n.left, position, first, last, follow);
+    }
+    return false;
+}
+// compute the Glushkov position automaton. position 0 is the start state, whose follow set is
+// the first set of the regex. symbols[0] is unused
+bool RegexTree::glushkov(std::vector<char>& symbols, std::vector<int>& first, std::vector<int>& last,
+                         std::vector<std::vector<int> >& follow) const {
+    // symbol nodes are created left to right, so node order is the order of occurrence
+    std::vector<int> position(this->nodes.size(), -1);
+    symbols.assign(1, epsilon);
+    for (size_t i = 0; i < this->nodes.size(); i++) {
+        if (this->nodes[i].kind == REGEX_SYMBOL) {
+            position[i] = symbols.size();
+            symbols.push_back(this->nodes[i].symbol);
+        }
+    }
+    follow.assign(symbols.size(), std::vector<int>());
+    bool nullable = this->positions(this->root, position, first, last, follow);
+    follow[0] = first;
+    return nullable;
+}
+// build the epsilon free Glushkov NFA: state i is position i and every arrow into a
+// position is labelled with its symbol. the start state accepts if the regex is nullable
+void RegexTree::convertToNFA(NFA& nfa) const {
+    std::vector<char> symbols;
+    std::vector<int> first, last;
+    std::vector<std::vector<int> > follow;
+    bool nullable = this->glushkov(symbols, first, last, follow);
+    nfa.setSymbols(this->getSymbols());
+    for (size_t i = 0; i < symbols.size(); i++) {
+        nfa.addState(std::to_string(i));
+    }
+    nfa.setStartState("0");
+    if (nullable) {
+        nfa.addAcceptState("0");
+    }
+    std::vector<int>::iterator it;
+    for (it = last.begin(); it != last.end(); it++) {
+        nfa.addAcceptState(std::to_string(*it));
+    }
+    for (size_t i = 0; i < follow.size(); i++) {
+        for (it = follow[i].begin(); it != follow[i].end(); it++) {
+            nfa.addTransition(std::make_pair(std::to_string(i), symbols[*it]), std::to_string(*it));
+        }
+    }
+}
+
+// GLUSHKOVMATCHER CLASS /////////////////////////////////////////////////////////
+
+GlushkovMatcher::GlushkovMatcher(const RegexTree& tree) {
+    std::vector<char> symbols;
+    std::vector<int> first, last;
+    std::vector<std::vector<int> > follow;
+    bool nullable = tree.glushkov(symbols, first, last, follow);
+    size_t positions = symbols.size();
+    this->positions = positions;
+    this->words = (positions + 63) / 64;
+    size_t chunks = (positions + 7) / 8;
+    // follow mask of every single position
+    std::vector<uint64_t> single(positions * this->words, 0);
+    for (size_t i = 0; i < positions; i++) {
+        std::vector<int>::iterator it;
+        for (it = follow[i].begin(); it != follow[i].end(); it++) {
+            single[i * this->words + *it / 64] |= (uint64_t)1 << (*it % 64);
+        }
+    }
+    // the follow mask of a chunk value is the union of its bits, built from the value with
+    // its lowest bit cleared
+    this->follow.assign(chunks * 256 * this->words, 0);
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        uint64_t* table = &this->follow[chunk * 256 * this->words];
+        for (unsigned int value = 1; value < 256; value++) {
+            unsigned int low = value & (~value + 1);
+            unsigned int bit = 0;
+            while ((1u << bit) != low) {
+                bit++;
+            }
+            size_t position = chunk * 8 + bit;
+            for (size_t w = 0; w < this->words; w++) {
+                table[value * this->words + w] = table[(value & (value - 1)) * this->words + w];
+                if (position < positions) {
+                    table[value * this->words + w] |= single[position * this->words + w];
+                }
+            }
+        }
+    }
+    this->symbolMasks.assign(256 * this->words, 0);
+    for (size_t i = 1; i < positions; i++) {
+        this->symbolMasks[(unsigned char)symbols[i] * this->words + i / 64] |= (uint64_t)1 << (i % 64);
+    }
+    this->lastMask.assign(this->words, 0);
+    std::vector<int>::iterator it;
+    for (it = last.begin(); it != last.end(); it++) {
+        this->lastMask[*it / 64] |= (uint64_t)1 << (*it % 64);
+    }
+    if (nullable) {
+        this->lastMask[0] |= 1;
+    }
+}
+// one step: union of the follow masks of the active positions, masked with the symbol
+void GlushkovMatcher::step(const std::vector<uint64_t>& current, std::vector<uint64_t>& next, unsigned char symbol) const {
+    std::fill(next.begin(), next.end(), 0);
+    for (size_t w = 0; w < this->words; w++) {
+        uint64_t bits = current[w];
+        for (size_t b = 0; bits != 0; b++, bits >>= 8) {
+            unsigned int value = bits & 0xFF;
+            if (value == 0) {
+                continue;
+            }
+            const uint64_t* mask = &this->follow[((w * 8 + b) * 256 + value) * this->words];
+            for (size_t i = 0; i < this->words; i++) {
+                next[i] |= mask[i];
+            }
+        }
+    }
+    const uint64_t* mask = &this->symbolMasks[symbol * this->words];
+    for (size_t i = 0; i < this->words; i++) {
+        next[i] &= mask[i];
+    }
+}
+// whether the whole string matches
+bool GlushkovMatcher::accepts(const std::string& input) const {
+    std::vector<uint64_t> current(this->words, 0);
+    std::vector<uint64_t> next(this->words, 0);
+    current[0] = 1;
+    std::string::const_iterator it;
+    for (it = input.begin(); it != input.end(); it++) {
+        this->step(current, next, *it);
+        current.swap(next);
+        bool active = false;
+        for (size_t i = 0; i < this->words; i++) {
+            active = active or current[i] != 0;
+        }
+        if (!active) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < this->words; i++) {
+        if (current[i] & this->lastMask[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+// number of positions, including the start position
+size_t GlushkovMatcher::size() const {
+    return this->positions;
+}
+
+// DERIVATIVEREGEX CLASS /////////////////////////////////////////////////////////
+
+DerivativeRegex::DerivativeRegex() {
+    this->emptyNode = this->make(REGEX_EMPTY, 0, std::vector<int>());
+    this->epsilonNode = this->make(REGEX_EPSILON, 0, std::vector<int>());
+    this->root = this->emptyNode;
+}
+DerivativeRegex::DerivativeRegex(const std::string& text) {
+    this->emptyNode = this->make(REGEX_EMPTY, 0, std::vector<int>());
+    this->epsilonNode = this->make(REGEX_EPSILON, 0, std::vector<int>());
+    this->root = this->emptyNode;
+    this->parse(text);
+}
+DerivativeRegex::DerivativeRegex(const RegexTree& tree) {
+    this->emptyNode = this->make(REGEX_EMPTY, 0, std::vector<int>());
+    this->epsilonNode = this->make(REGEX_EPSILON, 0, std::vector<int>());
+    this->symbols = tree.getSymbols();
+    this->root = this->fromTree(tree, tree.root);
+}
+// parse a regex, returns false on a syntax error
+bool DerivativeRegex::parse(const std::string& text) {
+    RegexTree tree;
+    bool parsed = tree.parse(text);
+    this->symbols = tree.getSymbols();
+    this->root = this->fromTree(tree, tree.root);
+    return parsed;
+}
+// returns the shared node for the given expression, creating it if needed
+int DerivativeRegex::make(RegexKind kind, char symbol, std::vector<int> children) {
+    std::pair<std::pair<int, char>, std::vector<int> > key(std::make_pair((int)kind, symbol), children);
+    std::map<std::pair<std::pair<int, char>, std::vector<int> >, int>::iterator found = this->index.find(key);
+    if (found != this->index.end()) {
+        return found->second;
+    }
+    Node node;
+    node.kind = kind;
+    node.symbol = symbol;
+    node.children = children;
+    switch (kind) {
+        // fromTree leaves out groups
+        case REGEX_GROUP:
+        case REGEX_EMPTY:
+        case REGEX_SYMBOL:
+            node.nullable = false;
+            break;
+        case REGEX_EPSILON:
+        case REGEX_STAR:
+            node.nullable = true;
+            break;
+        case REGEX_UNION:
+            node.nullable = false;
+            for (size_t i = 0; i < children.size(); i++) {
+                node.nullable = node.nullable or this->nodes[children[i]].nullable;
+            }
+            break;
+        case REGEX_CONCAT:
+            node.nullable = true;
+            for (size_t i = 0; i < children.size(); i++) {
+                node.nullable = node.nullable and this->nodes[children[i]].nullable;
+            }
+            break;
+    }
+    this->nodes.push_back(node);
+    int id = this->nodes.size() - 1;
+    this->index.insert(std::make_pair(key, id));
+    return id;
+}
+int DerivativeRegex::symbolNode(char symbol) {
+    return this->make(REGEX_SYMBOL, symbol, std::vector<int>());
+}
+// r + r = r, r + empty = r and unions are associative and commutative, so a union
+// is stored as a sorted set of its non union members
+int DerivativeRegex::unionNode(std::vector<int> children) {
+    std::vector<int> members;
+    for (size_t i = 0; i < children.size(); i++) {
+        const Node& child = this->nodes[children[i]];
+        if (child.kind == REGEX_UNION) {
+            members.insert(members.end(), child.children.begin(), child.children.end());
+        }
+        else if (child.kind != REGEX_EMPTY) {
+            members.push_back(children[i]);
+        }
+    }
+    std::sort(members.begin(), members.end());
+    members.erase(std::unique(members.begin(), members.end()), members.end());
+    if (members.empty()) {
+        return this->emptyNode;
+    }
+    if (members.size() == 1) {
+        return members[0];
+    }
+    return this->make(REGEX_UNION, 0, members);
+}
+// concatenation is associative, empty r = empty and epsilon r = r
+int DerivativeRegex::concatenationNode(std::vector<int> children) {
+    std::vector<int> members;
+    for (size_t i = 0; i < children.size(); i++) {
+        const Node& child = this->nodes[children[i]];
+        if (child.kind == REGEX_EMPTY) {
+            return this->emptyNode;
+        }
+        if (child.kind == REGEX_CONCAT) {
+            members.insert(members.end(), child.children.begin(), child.children.end());
+        }
+        else if (child.kind != REGEX_EPSILON) {
+            members.push_back(children[i]);
+        }
+    }
+    if (members.empty()) {
+        return this->epsilonNode;
+    }
+    if (members.size() == 1) {
+        return members[0];
+    }
+    return this->make(REGEX_CONCAT, 0, members);
+}
+// (r*)* = r*, empty* = epsilon* = epsilon
+int DerivativeRegex::starNode(int child) {
+    RegexKind kind = this->nodes[child].kind;
+    if (kind == REGEX_STAR) {
+        return child;
+    }
+    if (kind == REGEX_EMPTY or kind == REGEX_EPSILON) {
+        return this->epsilonNode;
+    }
+    return this->make(REGEX_STAR, 0, std::vector<int>(1, child));
+}
+int DerivativeRegex::fromTree(const RegexTree& tree, int node) {
+    const RegexNode& n = tree.nodes[node];
+    std::vector<int> children;
+    switch (n.kind) {
+        case REGEX_EMPTY:
+            return this->emptyNode;
+        case REGEX_EPSILON:
+            return this->epsilonNode;
+        case REGEX_SYMBOL:
+            return this->symbolNode(n.symbol);
+        case REGEX_UNION:
+            children.push_back(this->fromTree(tree, n.left));
+            children.push_back(this->fromTree(tree, n.right));
+            return this->unionNode(children);
+        case REGEX_CONCAT:
+            children.push_back(this->fromTree(tree, n.left));
+            children.push_back(this->fromTree(tree, n.right));
+            return this->concatenationNode(children);
+        case REGEX_STAR:
+            return this->starNode(this->fromTree(tree, n.left));
+        case REGEX_GROUP:
+            return this->fromTree(tree, n.left);
+    }
+    return this->emptyNode;
+}
+// the derivative of a node with respect to a symbol:
+// d(a) = epsilon, d(r+s) = d(r)+d(s), d(r*) = d(r)r*
+// d(r1 r2 .. rn) = d(r1)r2..rn + d(r2..rn) if r1 is nullable
+int DerivativeRegex::derivative(int node, char symbol) {
+    unsigned char value = symbol;
+    if (!this->nodes[node].next.empty() and this->nodes[node].next[value] >= 0) {
+        return this->nodes[node].next[value];
+    }
+    // building nodes can move the node vector, so take copies
+    RegexKind kind = this->nodes[node].kind;
+    std::vector<int> children = this->nodes[node].children;
+    int result = this->emptyNode;
+    switch (kind) {
+        case REGEX_GROUP:
+        case REGEX_EMPTY:
+        case REGEX_EPSILON:
+            break;
+        case REGEX_SYMBOL:
+            if (this->nodes[node].symbol == symbol) {
+                result = this->epsilonNode;
+            }
+            break;
+        case REGEX_UNION: {
+            std::vector<int> derivatives;
+            for (size_t i = 0; i < children.size(); i++) {
+                derivatives.push_back(this->derivative(children[i], symbol));
+            }
+            result = this->unionNode(derivatives);
+            break;
+        }
+        case REGEX_CONCAT: {
+            std::vector<int> parts;
+            for (size_t i = 0; i < children.size(); i++) {
+                std::vector<int> part(1, this->derivative(children[i], symbol));
+                part.insert(part.end(), children.begin() + i + 1, children.end());
+                parts.push_back(this->concatenationNode(part));
+                if (!this->nodes[children[i]].nullable) {
+                    break;
+                }
+            }
+            result = this->unionNode(parts);
+            break;
+        }
+        case REGEX_STAR: {
+            std::vector<int> part;
+            part.push_back(this->derivative(children[0], symbol));
+            part.push_back(node);
+            result = this->concatenationNode(part);
+            break;
+        }
+    }
+    if (this->nodes[node].next.empty()) {
+        this->nodes[node].next.assign(256, -1);
+    }
+    this->nodes[node].next[value] = result;
+    return result;
+}
+// whether the whole string matches, deriving one symbol at a time
+bool DerivativeRegex::accepts(const std::string& input) {
+    int state = this->root;
+    std::string::const_iterator it;
+    for (it = input.begin(); it != input.end(); it++) {
+        state = this->derivative(state, *it);
+        if (state == this->emptyNode) {
+            return false;
+        }
+    }
+    return this->nodes[state].nullable;
+}
+// build the DFA with one state per distinct derivative reachable from the regex. states are
+// numbered in breadth first order, the empty language becomes the dead state
+void DerivativeRegex::convertToDFA(DFA& dfa) {
+    dfa.setSymbols(this->symbols);
+    std::map<int, std::string> names;
+    std::vector<int> order(1, this->root);
+    names[this->root] = "";
+    for (size_t i = 0; i < order.size(); i++) {
+        std::vector<char>::iterator symbol;
+        for (symbol = this->symbols.begin(); symbol != this->symbols.end(); symbol++) {
+            int next = this->derivative(order[i], *symbol);
+            if (names.insert(std::make_pair(next, "")).second) {
+                order.push_back(next);
+            }
+        }
+    }
+    for (size_t i = 0; i < order.size(); i++) {
+        names[order[i]] = order[i] == this->emptyNode ? deadstatename : std::to_string(i);
+        dfa.addState(names[order[i]]);
+        if (this->nodes[order[i]].nullable) {
+            dfa.addAcceptState(names[order[i]]);
+        }
+    }
+    dfa.setStartState(names[this->root]);
+    std::vector<int>::iterator state;
+    for (state = order.begin(); state != order.end(); state++) {
+        std::vector<char>::iterator symbol;
+        for (symbol = this->symbols.begin(); symbol != this->symbols.end(); symbol++) {
+            dfa.addTransition(std::make_pair(names[*state], *symbol), names[this->derivative(*state, *symbol)]);
+        }
+    }
+}
+// number of distinct expressions built so far
+size_t DerivativeRegex::size() const {
+    return this->nodes.size();
+}
+// write a node in regex syntax
+std::string DerivativeRegex::toString(int node) const {
+    const Node& n = this->nodes[node];
+    std::string result;
+    switch (n.kind) {
+        case REGEX_GROUP:
+        case REGEX_EMPTY:
+            return " ";
+        case REGEX_EPSILON:
+            return std::string(1, legacyepsilon);
+        case REGEX_SYMBOL:
+            return regexSymbol(n.symbol);
+        case REGEX_UNION:
+            for (size_t i = 0; i < n.children.size(); i++) {
+                result += (i > 0 ? "+" : "") + this->toString(n.children[i]);
+            }
+            return result;
+        case REGEX_CONCAT:
+            for (size_t i = 0; i < n.children.size(); i++) {
+                std::string child = this->toString(n.children[i]);
+                if (this->nodes[n.children[i]].kind == REGEX_UNION) {
+                    child = "(" + child + ")";
+                }
+                result += child;
+            }
+            return result;
+        case REGEX_STAR:
+            result = this->toString(n.children[0]);
+            if (this->nodes[n.children[0]].kind != REGEX_SYMBOL) {
+                result = "(" + result + ")";
+            }
+            return result + "*";
+    }
+    return result;
+}
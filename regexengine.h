@@ -0,0 +1,150 @@
+/* Regular expressions in the syntax convertToRegex produces:
+ * juxtaposition is concatenation, '+' is union, '*' is the Kleene star, parentheses group,
+ * 'E' is epsilon and ' ' (a space) is the empty language. A backslash makes the next
+ * character a literal symbol (\E, \+, \*, \(, \), \ , \\) and \xHH is any byte.
+ * RegexTree keeps the expression as it was written. DerivativeRegex builds DFAs from it
+ * with Brzozowski derivatives, or matches lazily without building anything up front.
+ * The Glushkov construction turns it into an epsilon free NFA with one state per symbol
+ * occurrence, which GlushkovMatcher simulates with bit vectors.
+ * When RegexTree is asked to parse capture groups, braces mark a group: {r} matches what r
+ * matches and numbers the group by its opening brace, starting at 1 (\{ and \} are literal).
+ * Only the tagged automata of tagged.h look at groups, everything else sees through them.
+**/
+#ifndef REGEXENGINE_H_
+#define REGEXENGINE_H_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <stdint.h>
+#include "automata.h"
+
+// kinds of regex nodes
+enum RegexKind {
+    REGEX_EMPTY,
+    REGEX_EPSILON,
+    REGEX_SYMBOL,
+    REGEX_UNION,
+    REGEX_CONCAT,
+    REGEX_STAR,
+    REGEX_GROUP
+};
+
+// a node of a regex syntax tree, children are indices into the same tree (-1 if unused). a
+// group has its number in right
+struct RegexNode {
+    RegexKind kind;
+    char symbol;
+    int left;
+    int right;
+    RegexNode(RegexKind, char, int, int);
+};
+
+// a parsed regex in which every symbol occurrence is its own node
+class RegexTree {
+    private:
+        std::string text;
+        size_t pos;
+        bool failed;
+        bool captures;
+        int groups;
+        int add(RegexKind, char, int, int);
+        int parseUnion();
+        int parseConcatenation();
+        int parseStar();
+        int parseAtom();
+        // nullable, first and last positions of a subtree (given the position of every symbol
+        // node), adding to the follow sets
+        bool positions(int, const std::vector<int>&, std::vector<int>&, std::vector<int>&,
+                       std::vector<std::vector<int> >&) const;
+    public:
+        std::vector<RegexNode> nodes;
+        int root;
+        RegexTree();
+        explicit RegexTree(const std::string&);
+        // parse the text, returns false (leaving the empty language) on a syntax error. with
+        // captures, braces are capture groups instead of symbols
+        bool parse(const std::string&, bool = false);
+        // number of capture groups
+        int getGroupCount() const;
+        // the symbols occurring in the regex, in order of appearance
+        std::vector<char> getSymbols() const;
+        // write the regex back in the same syntax
+        std::string toString(int) const;
+        std::string toString() const;
+        // compute the Glushkov position automaton: position 0 is the start, position i > 0 is
+        // the i-th symbol occurrence. returns whether the empty string matches and fills the
+        // symbol of every position, the first and last positions and the follow set of each
+        bool glushkov(std::vector<char>&, std::vector<int>&, std::vector<int>&, std::vector<std::vector<int> >&) const;
+        // build the epsilon free Glushkov NFA, with states named after their positions
+        void convertToNFA(NFA&) const;
+};
+
+// bit parallel simulation of the Glushkov automaton of a regex. every position is a bit;
+// all arrows into a position carry its symbol, so a step is the union of the follow sets of
+// the active positions (looked up per byte of the state vector) masked with the positions of
+// the symbol read.
+class GlushkovMatcher {
+    private:
+        size_t positions;
+        size_t words;
+        // follow masks per 8 position chunk and chunk value, words masks per entry
+        std::vector<uint64_t> follow;
+        // positions per symbol, words masks per byte
+        std::vector<uint64_t> symbolMasks;
+        std::vector<uint64_t> lastMask;
+        void step(const std::vector<uint64_t>&, std::vector<uint64_t>&, unsigned char) const;
+    public:
+        explicit GlushkovMatcher(const RegexTree&);
+        // whether the whole string matches
+        bool accepts(const std::string&) const;
+        // number of positions, including the start position
+        size_t size() const;
+};
+
+// regex engine based on Brzozowski derivatives. expressions are normalized when they are
+// built (unions are flattened, sorted and deduplicated, concatenation is flattened,
+// empty language and epsilon are simplified away) and shared, so equal derivatives are the
+// same node. every node is a DFA state, with its derivatives as successors.
+class DerivativeRegex {
+    private:
+        struct Node {
+            RegexKind kind;
+            char symbol;
+            std::vector<int> children;
+            bool nullable;
+            // derivative per byte, filled lazily (-1 = not computed yet)
+            std::vector<int> next;
+        };
+        std::vector<Node> nodes;
+        std::map<std::pair<std::pair<int, char>, std::vector<int> >, int> index;
+        std::vector<char> symbols;
+        int root;
+        int emptyNode;
+        int epsilonNode;
+        int make(RegexKind, char, std::vector<int>);
+        int symbolNode(char);
+        int unionNode(std::vector<int>);
+        int concatenationNode(std::vector<int>);
+        int starNode(int);
+        int fromTree(const RegexTree&, int);
+    public:
+        DerivativeRegex();
+        explicit DerivativeRegex(const std::string&);
+        explicit DerivativeRegex(const RegexTree&);
+        // parse a regex, returns false on a syntax error
+        bool parse(const std::string&);
+        // the derivative of a node with respect to a symbol
+        int derivative(int, char);
+        // whether the whole string matches. derivatives are computed on the fly and cached,
+        // so nothing is built before matching starts
+        bool accepts(const std::string&);
+        // build the DFA with one state per distinct derivative reachable from the regex
+        void convertToDFA(DFA&);
+        // number of distinct expressions built so far
+        size_t size() const;
+        // write a node in regex syntax
+        std::string toString(int) const;
+};
+
+#endif
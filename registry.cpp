@@ -0,0 +1,208 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <iostream>
+#include <chrono>
+#include "registry.h"
+
+// HELPER FUNCTIONS //////////////////////////////////////////////////////////////
+
+// read a file into a DFA the way its type asks for, false when the file has no known type
+static bool parseDFA(const std::string& filename, DFA& result) {
+    AutomataParser parser(filename);
+    if (!parser.makeDFA(result)) {
+        std::cerr << "Unknown type of automaton in " << filename << ", not loaded." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// AUTOMATONVERSION STRUCT ///////////////////////////////////////////////////////
+
+AutomatonVersion::AutomatonVersion(const DFA& dfa, size_t version): compiled(dfa), scanner(dfa), version(version) {
+}
+
+// AUTOMATONREGISTRY CLASS ///////////////////////////////////////////////////////
+
+AutomatonRegistry::AutomatonRegistry(const std::vector<std::string>& filenames, size_t readers):
+    entries(filenames.size()), slots(readers), slotTaken(readers, false), epoch(1), stopping(false) {
+    for (size_t i = 0; i < filenames.size(); i++) {
+        this->entries[i].filename = filenames[i];
+        this->entries[i].modified.tv_sec = 0;
+        this->entries[i].modified.tv_nsec = 0;
+    }
+}
+// stop the poller and free every version
+AutomatonRegistry::~AutomatonRegistry() {
+    this->stop();
+    std::vector<Entry>::iterator entry;
+    for (entry = this->entries.begin(); entry != this->entries.end(); entry++) {
+        delete entry->current.load();
+    }
+    std::vector<Retired>::iterator it;
+    for (it = this->retired.begin(); it != this->retired.end(); it++) {
+        delete it->version;
+    }
+}
+// load a file if it looks different from when it was loaded last, or always when forced, and
+// publish the new version
+bool AutomatonRegistry::reload(size_t file, bool force) {
+    Entry& entry = this->entries[file];
+    struct stat info;
+    if (stat(entry.filename.c_str(), &info) != 0) {
+        if (force or !entry.unreadable) {
+            std::cerr << "Could not read " << entry.filename << ", keeping the version loaded." << std::endl;
+        }
+        entry.unreadable = true;
+        return false;
+    }
+    entry.unreadable = false;
+    bool changed = info.st_mtim.tv_sec != entry.modified.tv_sec or info.st_mtim.tv_nsec != entry.modified.tv_nsec
+                   or info.st_size != entry.size;
+    if (!force and !changed) {
+        return true;
+    }
+    // remember the state before parsing, a change during the parse is seen by the next poll
+    entry.modified = info.st_mtim;
+    entry.size = info.st_size;
+    DFA dfa;
+    if (!parseDFA(entry.filename, dfa)) {
+        return false;
+    }
+    const AutomatonVersion* version = new AutomatonVersion(dfa, ++entry.versions);
+    const AutomatonVersion* old = entry.current.exchange(version);
+    if (old != NULL) {
+        Retired replaced;
+        replaced.version = old;
+        // readers pinned in this epoch or before may still hold the old version, readers that
+        // pin after the epoch has moved on get the new one
+        replaced.epoch = this->epoch.fetch_add(1);
+        this->retired.push_back(replaced);
+    }
+    this->collect();
+    return true;
+}
+// free the retired versions older than the oldest epoch a pinned reader announced
+void AutomatonRegistry::collect() {
+    uint64_t oldest = this->epoch.load();
+    std::vector<ReaderSlot>::iterator slot;
+    for (slot = this->slots.begin(); slot != this->slots.end(); slot++) {
+        uint64_t announced = slot->epoch.load();
+        if (announced != 0 and announced < oldest) {
+            oldest = announced;
+        }
+    }
+    std::vector<Retired> waiting;
+    std::vector<Retired>::iterator it;
+    for (it = this->retired.begin(); it != this->retired.end(); it++) {
+        if (it->epoch < oldest) {
+            delete it->version;
+        }
+        else {
+            waiting.push_back(*it);
+        }
+    }
+    this->retired.swap(waiting);
+}
+// load every file now
+bool AutomatonRegistry::loadAll() {
+    std::unique_lock<std::mutex> guard(this->loading);
+    bool loaded = true;
+    for (size_t file = 0; file < this->entries.size(); file++) {
+        loaded = this->reload(file, true) and loaded;
+    }
+    return loaded;
+}
+// load one file now
+bool AutomatonRegistry::load(size_t file) {
+    std::unique_lock<std::mutex> guard(this->loading);
+    return this->reload(file, true);
+}
+// load the files that changed, and free what the readers let go of since the last time
+bool AutomatonRegistry::reloadChanged() {
+    std::unique_lock<std::mutex> guard(this->loading);
+    bool loaded = true;
+    for (size_t file = 0; file < this->entries.size(); file++) {
+        loaded = this->reload(file, false) and loaded;
+    }
+    this->collect();
+    return loaded;
+}
+// reload changed files at every interval until stopped
+void AutomatonRegistry::poll(unsigned long interval) {
+    std::unique_lock<std::mutex> guard(this->pollerLock);
+    while (!this->stopping) {
+        this->wakeup.wait_for(guard, std::chrono::milliseconds(interval));
+        if (this->stopping) {
+            break;
+        }
+        guard.unlock();
+        this->reloadChanged();
+        guard.lock();
+    }
+}
+// start the poller, unless it runs already
+void AutomatonRegistry::watch(unsigned long interval) {
+    std::unique_lock<std::mutex> guard(this->pollerLock);
+    if (this->poller.joinable()) {
+        return;
+    }
+    this->stopping = false;
+    this->poller = std::thread(&AutomatonRegistry::poll, this, interval);
+}
+// stop the poller and wait for it
+void AutomatonRegistry::stop() {
+    {
+        std::unique_lock<std::mutex> guard(this->pollerLock);
+        this->stopping = true;
+    }
+    this->wakeup.notify_all();
+    if (this->poller.joinable()) {
+        this->poller.join();
+    }
+}
+// number of files
+size_t AutomatonRegistry::size() const {
+    return this->entries.size();
+}
+// return the name of a file
+std::string AutomatonRegistry::getFilename(size_t file) const {
+    return this->entries[file].filename;
+}
+// number of replaced versions waiting for readers
+size_t AutomatonRegistry::getRetiredCount() {
+    std::unique_lock<std::mutex> guard(this->loading);
+    return this->retired.size();
+}
+// hand out a free reader slot, -1 when there is none
+int AutomatonRegistry::takeSlot() {
+    std::unique_lock<std::mutex> guard(this->readers);
+    for (size_t slot = 0; slot < this->slotTaken.size(); slot++) {
+        if (!this->slotTaken[slot]) {
+            this->slotTaken[slot] = true;
+            return slot;
+        }
+    }
+    std::cerr << "No reader slots left in the registry." << std::endl;
+    return -1;
+}
+// take back a reader slot
+void AutomatonRegistry::releaseSlot(int slot) {
+    std::unique_lock<std::mutex> guard(this->readers);
+    this->slots[slot].epoch.store(0);
+    this->slotTaken[slot] = false;
+}
+
+// REGISTRYREADER CLASS //////////////////////////////////////////////////////////
+
+RegistryReader::RegistryReader(AutomatonRegistry& registry): registry(registry), slot(registry.takeSlot()) {
+}
+RegistryReader::~RegistryReader() {
+    if (this->slot >= 0) {
+        this->registry.releaseSlot(this->slot);
+    }
+}
+// whether the reader got a slot
+bool RegistryReader::isValid() const {
+    return this->slot >= 0;
+}
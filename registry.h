@@ -0,0 +1,157 @@
+/* Reloading automata from their files while matchers keep running.
+ * AutomatonRegistry owns one entry per .fa file, holding the version of its automaton that
+ * matchers should use: the file compiled into a CompiledDFA and a Scanner, which never
+ * change once built. Loading parses and converts a file on the calling thread, or on a
+ * poller thread that reloads every file whose modification time or size changed, and only
+ * then publishes the new version by swapping it into the entry's atomic pointer. A file
+ * that doesn't parse keeps the version it had.
+ * Readers never lock. Each reader thread takes a RegistryReader and pins it while it uses
+ * versions (epoch based reclamation): pinning announces the registry epoch the reader saw,
+ * a swap retires the old version under the epoch it happened in and moves the epoch on,
+ * and a retired version is freed once no pinned reader announces an epoch up to its own.
+ * A reader pinned before a swap may keep using the old version until it unpins; a reader
+ * pinned after it sees the new one.
+ * Files are best replaced by renaming a complete file over them, so the poller never
+ * reads one that is half written.
+**/
+#ifndef REGISTRY_H_
+#define REGISTRY_H_
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "matcher.h"
+
+// one version of the automaton of a file
+struct AutomatonVersion {
+    AutomatonVersion(const DFA&, size_t);
+    const CompiledDFA compiled;
+    const Scanner scanner;
+    // counts the versions published for the file, from 1
+    const size_t version;
+};
+
+class RegistryReader;
+
+class AutomatonRegistry {
+    private:
+        AutomatonRegistry(const AutomatonRegistry&);
+        AutomatonRegistry operator=(const AutomatonRegistry&);
+        // a file and the version published for it
+        struct Entry {
+            std::string filename;
+            std::atomic<const AutomatonVersion*> current;
+            // what the file looked like when it was loaded last, only seen by the loader
+            struct timespec modified;
+            off_t size;
+            size_t versions;
+            // whether the file could not be read last time, so polls only report it once
+            bool unreadable;
+            Entry(): current(NULL), size(-1), versions(0), unreadable(false) {}
+        };
+        // the epoch a reader announced, 0 while it is not pinned. one per cache line, so
+        // readers don't slow each other down
+        struct ReaderSlot {
+            std::atomic<uint64_t> epoch;
+            char padding[64 - sizeof(std::atomic<uint64_t>)];
+            ReaderSlot(): epoch(0) {}
+        };
+        // a version replaced in the given epoch, waiting for its readers to unpin
+        struct Retired {
+            const AutomatonVersion* version;
+            uint64_t epoch;
+        };
+        std::vector<Entry> entries;
+        std::vector<ReaderSlot> slots;
+        std::vector<bool> slotTaken;
+        std::atomic<uint64_t> epoch;
+        std::vector<Retired> retired;
+        // taken by loading and freeing, never by readers
+        std::mutex loading;
+        // taken by readers only when they come and go
+        std::mutex readers;
+        std::thread poller;
+        bool stopping;
+        std::mutex pollerLock;
+        std::condition_variable wakeup;
+        // load a file if it changed since it was loaded last (or always), with the loading
+        // lock held. false when it changed but could not be loaded
+        bool reload(size_t, bool);
+        // free the retired versions that no pinned reader can hold any more
+        void collect();
+        // reload changed files every given number of milliseconds until stopped
+        void poll(unsigned long);
+        int takeSlot();
+        void releaseSlot(int);
+        friend class RegistryReader;
+    public:
+        // a registry for the given files, with room for the given number of reader threads.
+        // nothing is loaded yet
+        AutomatonRegistry(const std::vector<std::string>&, size_t = 64);
+        // stop the poller and free every version. no reader may be left
+        ~AutomatonRegistry();
+        // load every file now, false when one of them could not be loaded
+        bool loadAll();
+        // load a file now, false when it can't be parsed
+        bool load(size_t);
+        // load the files that changed since they were loaded last, false when one of them
+        // could not be loaded
+        bool reloadChanged();
+        // start a thread that reloads changed files every given number of milliseconds
+        void watch(unsigned long = 1000);
+        // stop that thread
+        void stop();
+        // number of files
+        size_t size() const;
+        std::string getFilename(size_t) const;
+        // number of replaced versions that are not freed yet
+        size_t getRetiredCount();
+};
+
+// the way a thread reads a registry. a reader belongs to one thread at a time
+class RegistryReader {
+    private:
+        RegistryReader(const RegistryReader&);
+        RegistryReader operator=(const RegistryReader&);
+        AutomatonRegistry& registry;
+        int slot;
+    public:
+        // take a reader slot, which is the only time a reader locks
+        explicit RegistryReader(AutomatonRegistry&);
+        // give the slot back, unpinning first
+        ~RegistryReader();
+        // whether the registry had a slot left for this reader. a reader without one can't
+        // pin, and get always returns NULL
+        bool isValid() const;
+        // from here until unpin the versions get returns stay alive
+        void pin();
+        void unpin();
+        // the current version of a file, NULL when it was never loaded. only while pinned
+        const AutomatonVersion* get(size_t) const;
+};
+
+// announces the epoch a reader saw: the store and the loads after it are sequentially
+// consistent, so either the loader sees the announcement or the reader sees the new pointer
+inline void RegistryReader::pin() {
+    if (this->slot >= 0) {
+        this->registry.slots[this->slot].epoch.store(this->registry.epoch.load());
+    }
+}
+inline void RegistryReader::unpin() {
+    if (this->slot >= 0) {
+        this->registry.slots[this->slot].epoch.store(0, std::memory_order_release);
+    }
+}
+inline const AutomatonVersion* RegistryReader::get(size_t file) const {
+    if (this->slot < 0) {
+        return NULL;
+    }
+    return this->registry.entries[file].current.load();
+}
+
+#endif
@@ -0,0 +1,139 @@
+#include <vector>
+#include <string>
+#include <iostream>
+#include "service.h"
+
+// MATCHERSERVICE CLASS //////////////////////////////////////////////////////////
+
+MatcherService::MatcherService(size_t threads, size_t capacity, size_t batch):
+    workerCount(0), capacity(capacity == 0 ? 1 : capacity), batchSize(batch == 0 ? 1 : batch), stopping(false) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    this->workerCount = threads;
+    for (size_t i = 0; i < threads; i++) {
+        this->workers.push_back(std::thread(&MatcherService::work, this));
+    }
+}
+MatcherService::~MatcherService() {
+    this->stop();
+}
+// queue a job, waiting while the queue is full
+std::future<std::vector<Match> > MatcherService::enqueue(Job& job) {
+    std::future<std::vector<Match> > future = job.result.get_future();
+    {
+        std::unique_lock<std::mutex> guard(this->lock);
+        while (this->queue.size() >= this->capacity and !this->stopping) {
+            this->notFull.wait(guard);
+        }
+        if (this->stopping) {
+            std::cerr << "The matcher service has stopped, job refused." << std::endl;
+            job.result.set_value(std::vector<Match>());
+            return future;
+        }
+        this->queue.push_back(std::move(job));
+    }
+    this->notEmpty.notify_one();
+    return future;
+}
+// search a text, which is moved into the job
+std::future<std::vector<Match> > MatcherService::submit(std::shared_ptr<const Scanner> scanner, std::string text,
+                                                        MatchSemantics semantics) {
+    Job job;
+    job.scanner = scanner;
+    job.owned.swap(text);
+    job.text = NULL;
+    job.length = 0;
+    job.semantics = semantics;
+    return this->enqueue(job);
+}
+// search a buffer that has to stay alive until the result is ready
+std::future<std::vector<Match> > MatcherService::submit(std::shared_ptr<const Scanner> scanner, const char* text,
+                                                        size_t length, MatchSemantics semantics) {
+    Job job;
+    job.scanner = scanner;
+    job.text = text;
+    job.length = length;
+    job.semantics = semantics;
+    return this->enqueue(job);
+}
+// search every text and wait for the matches of all of them
+std::vector<std::vector<Match> > MatcherService::scanAll(std::shared_ptr<const Scanner> scanner,
+                                                         const std::vector<std::string>& texts,
+                                                         MatchSemantics semantics) {
+    std::vector<std::future<std::vector<Match> > > futures;
+    std::vector<std::string>::const_iterator text;
+    for (text = texts.begin(); text != texts.end(); text++) {
+        futures.push_back(this->submit(scanner, text->data(), text->size(), semantics));
+    }
+    std::vector<std::vector<Match> > results;
+    std::vector<std::future<std::vector<Match> > >::iterator future;
+    for (future = futures.begin(); future != futures.end(); future++) {
+        results.push_back(future->get());
+    }
+    return results;
+}
+// take batches of jobs from the queue until the service stops and the queue is empty. a
+// worker takes its share of the waiting jobs, at most a batch, so idle workers get some too
+void MatcherService::work() {
+    ScanScratch scratch;
+    std::vector<Job> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            while (this->queue.empty() and !this->stopping) {
+                this->notEmpty.wait(guard);
+            }
+            if (this->queue.empty()) {
+                return;
+            }
+            size_t take = this->queue.size() / this->workerCount;
+            if (take == 0) {
+                take = 1;
+            }
+            if (take > this->batchSize) {
+                take = this->batchSize;
+            }
+            for (size_t i = 0; i < take; i++) {
+                batch.push_back(std::move(this->queue.front()));
+                this->queue.pop_front();
+            }
+        }
+        this->notFull.notify_all();
+        std::vector<Job>::iterator job;
+        for (job = batch.begin(); job != batch.end(); job++) {
+            std::vector<Match> matches;
+            if (job->text == NULL) {
+                job->scanner->scan(job->owned.data(), job->owned.size(), matches, scratch, job->semantics);
+            }
+            else {
+                job->scanner->scan(job->text, job->length, matches, scratch, job->semantics);
+            }
+            job->result.set_value(std::move(matches));
+        }
+        batch.clear();
+    }
+}
+// finish the queued jobs and stop the workers, later jobs are refused
+void MatcherService::stop() {
+    {
+        std::unique_lock<std::mutex> guard(this->lock);
+        if (this->stopping) {
+            return;
+        }
+        this->stopping = true;
+    }
+    this->notEmpty.notify_all();
+    this->notFull.notify_all();
+    std::vector<std::thread>::iterator worker;
+    for (worker = this->workers.begin(); worker != this->workers.end(); worker++) {
+        worker->join();
+    }
+}
+// number of workers
+size_t MatcherService::size() const {
+    return this->workerCount;
+}
@@ -0,0 +1,69 @@
+/* A pool of worker threads running match jobs for many client threads.
+ * Scanners are shared through shared_ptr<const Scanner>: they never change after they are
+ * built, so every worker reads the same tables without locking. Each worker owns the
+ * ScanScratch it scans in. Jobs wait in a bounded queue; submitting blocks while the queue
+ * is full, so clients cannot run ahead of the workers. A worker takes a batch of jobs per
+ * lock acquisition, which keeps the queue lock out of the way of the scanning itself.
+**/
+#ifndef SERVICE_H_
+#define SERVICE_H_
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include "matcher.h"
+
+class MatcherService {
+    private:
+        struct Job {
+            std::shared_ptr<const Scanner> scanner;
+            // the text is owned by the job when the pointer is NULL, borrowed from the client
+            // otherwise (moving a job may move the characters of the owned string)
+            std::string owned;
+            const char* text;
+            size_t length;
+            MatchSemantics semantics;
+            std::promise<std::vector<Match> > result;
+        };
+        MatcherService(const MatcherService&);
+        MatcherService operator=(const MatcherService&);
+        std::vector<std::thread> workers;
+        size_t workerCount;
+        std::deque<Job> queue;
+        size_t capacity;
+        size_t batchSize;
+        bool stopping;
+        std::mutex lock;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+        // queue a job, waiting while the queue is full
+        std::future<std::vector<Match> > enqueue(Job&);
+        // take batches of jobs from the queue until the service stops
+        void work();
+    public:
+        // start the given number of workers (one per core when 0), with room for the given
+        // number of waiting jobs, taking at most the given number of jobs at a time
+        MatcherService(size_t threads = 0, size_t capacity = 1024, size_t batch = 16);
+        // finish the queued jobs and stop the workers
+        ~MatcherService();
+        // search a text, which is moved into the job
+        std::future<std::vector<Match> > submit(std::shared_ptr<const Scanner>, std::string,
+                                                MatchSemantics = MATCH_LEFTMOST_LONGEST);
+        // search a buffer that has to stay alive until the result is ready
+        std::future<std::vector<Match> > submit(std::shared_ptr<const Scanner>, const char*, size_t,
+                                                MatchSemantics = MATCH_LEFTMOST_LONGEST);
+        // search every text and wait for the matches of all of them
+        std::vector<std::vector<Match> > scanAll(std::shared_ptr<const Scanner>, const std::vector<std::string>&,
+                                                 MatchSemantics = MATCH_LEFTMOST_LONGEST);
+        // finish the queued jobs and stop the workers, later jobs are refused
+        void stop();
+        // number of workers
+        size_t size() const;
+};
+
+#endif
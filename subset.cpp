@@ -0,0 +1,514 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "subset.h"
+#include "parallel.h"
+
+// slots in the first hash table, a power of two
+static const size_t initialslots = 1 << 16;
+// size of the buffer in front of the output file
+static const size_t outputbuffersize = 1 << 20;
+// shards of the subset map of the parallel determinizer, a power of two
+static const size_t shardcount = 256;
+// slots a shard starts with, a power of two
+static const size_t initialshardslots = 64;
+// states per block of stored subsets
+static const size_t blockstates = 1 << 16;
+
+// HELPER FUNCTIONS //////////////////////////////////////////////////////////////
+
+// FNV-1a over the bytes of a subset, with the final mix of MurmurHash3
+static uint64_t hashSubset(const std::vector<uint32_t>& subset) {
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(subset.data());
+    for (size_t i = 0; i < subset.size() * sizeof(uint32_t); i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    // the multiplications of FNV only carry upwards, so mix the high bits into the low bits
+    // the tables index with
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// MAPPEDFILE CLASS //////////////////////////////////////////////////////////////
+
+MappedFile::MappedFile(): descriptor(-1), data(NULL), length(0) {
+}
+MappedFile::~MappedFile() {
+    this->remove();
+}
+// map the current length of the file
+bool MappedFile::map() {
+    void* address = mmap(NULL, this->length, PROT_READ | PROT_WRITE, MAP_SHARED, this->descriptor, 0);
+    if (address == MAP_FAILED) {
+        std::cerr << "Couldn't map '" << this->path << "' into memory." << std::endl;
+        this->data = NULL;
+        return false;
+    }
+    this->data = static_cast<char*>(address);
+    return true;
+}
+// create the file (emptying an existing one) with the given size, new bytes read as zero
+bool MappedFile::create(const std::string& path, size_t length) {
+    this->remove();
+    this->path = path;
+    this->descriptor = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (this->descriptor < 0) {
+        std::cerr << "Couldn't create '" << path << "'." << std::endl;
+        return false;
+    }
+    this->length = length;
+    if (ftruncate(this->descriptor, length) != 0) {
+        std::cerr << "Couldn't grow '" << path << "' to " << length << " bytes." << std::endl;
+        return false;
+    }
+    return this->map();
+}
+// grow the file to the given size, keeping the contents
+bool MappedFile::resize(size_t length) {
+    if (this->descriptor < 0) {
+        return false;
+    }
+    if (this->data != NULL) {
+        munmap(this->data, this->length);
+        this->data = NULL;
+    }
+    if (ftruncate(this->descriptor, length) != 0) {
+        std::cerr << "Couldn't grow '" << this->path << "' to " << length << " bytes." << std::endl;
+        return false;
+    }
+    this->length = length;
+    return this->map();
+}
+// unmap, close and delete the file
+void MappedFile::remove() {
+    if (this->data != NULL) {
+        munmap(this->data, this->length);
+        this->data = NULL;
+    }
+    if (this->descriptor >= 0) {
+        close(this->descriptor);
+        unlink(this->path.c_str());
+        this->descriptor = -1;
+    }
+    this->length = 0;
+}
+// trade files with another object
+void MappedFile::swap(MappedFile& other) {
+    std::swap(this->path, other.path);
+    std::swap(this->descriptor, other.descriptor);
+    std::swap(this->data, other.data);
+    std::swap(this->length, other.length);
+}
+// return the mapped bytes
+char* MappedFile::getData() const {
+    return this->data;
+}
+// return the size of the file
+size_t MappedFile::size() const {
+    return this->length;
+}
+
+// INDEXEDNFA CLASS //////////////////////////////////////////////////////////////
+
+IndexedNFA::IndexedNFA(const NFA& nfa): classOf(256, 0) {
+    std::vector<std::string> names = nfa.getStates();
+    std::map<std::string, uint32_t> index;
+    for (size_t i = 0; i < names.size(); i++) {
+        index[names[i]] = i;
+    }
+    this->states = names.size();
+    std::vector<std::vector<char> > symbolclasses = nfa.getSymbolClasses();
+    this->classes = symbolclasses.size() + 1;
+    for (size_t c = 0; c < symbolclasses.size(); c++) {
+        std::vector<char>::iterator symbol;
+        for (symbol = symbolclasses[c].begin(); symbol != symbolclasses[c].end(); symbol++) {
+            this->classOf[static_cast<unsigned char>(*symbol)] = c + 1;
+        }
+    }
+    // class 0 holds the bytes outside the alphabet and has no arrows
+    this->firstArrow.push_back(0);
+    for (size_t state = 0; state < this->states; state++) {
+        this->accepting.push_back(nfa.hasAcceptState(names[state]));
+        this->firstArrow.push_back(this->arrows.size());
+        for (size_t c = 0; c < symbolclasses.size(); c++) {
+            // delta of an ENFA already closes the targets under epsilon
+            std::vector<std::string> targets = nfa.delta(names[state], symbolclasses[c].front());
+            std::vector<uint32_t> numbers;
+            std::vector<std::string>::iterator target;
+            for (target = targets.begin(); target != targets.end(); target++) {
+                numbers.push_back(index[*target]);
+            }
+            std::sort(numbers.begin(), numbers.end());
+            numbers.erase(std::unique(numbers.begin(), numbers.end()), numbers.end());
+            this->arrows.insert(this->arrows.end(), numbers.begin(), numbers.end());
+            this->firstArrow.push_back(this->arrows.size());
+        }
+    }
+    std::vector<std::string> closure = nfa.getClosure(nfa.getStartState());
+    std::vector<std::string>::iterator state;
+    for (state = closure.begin(); state != closure.end(); state++) {
+        if (index.count(*state) > 0) {
+            this->startSet.push_back(index[*state]);
+        }
+    }
+    std::sort(this->startSet.begin(), this->startSet.end());
+    this->startSet.erase(std::unique(this->startSet.begin(), this->startSet.end()), this->startSet.end());
+}
+// the sorted set reached from a sorted set of states with a symbol class
+void IndexedNFA::step(const std::vector<uint32_t>& subset, size_t symbolclass, std::vector<uint32_t>& result) const {
+    result.clear();
+    std::vector<uint32_t>::const_iterator state;
+    for (state = subset.begin(); state != subset.end(); state++) {
+        size_t slot = *state * this->classes + symbolclass;
+        result.insert(result.end(), this->arrows.begin() + this->firstArrow[slot],
+                      this->arrows.begin() + this->firstArrow[slot + 1]);
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+// whether a set of states contains an accept state
+bool IndexedNFA::accepts(const std::vector<uint32_t>& subset) const {
+    std::vector<uint32_t>::const_iterator state;
+    for (state = subset.begin(); state != subset.end(); state++) {
+        if (this->accepting[*state]) {
+            return true;
+        }
+    }
+    return false;
+}
+// the closure of the start state
+const std::vector<uint32_t>& IndexedNFA::getStartSet() const {
+    return this->startSet;
+}
+// number of symbol classes, including class 0 for the bytes outside the alphabet
+size_t IndexedNFA::getClassCount() const {
+    return this->classes;
+}
+// return the symbol class of a byte
+int IndexedNFA::getSymbolClass(unsigned char byte) const {
+    return this->classOf[byte];
+}
+// number of states
+size_t IndexedNFA::size() const {
+    return this->states;
+}
+
+// OUTOFCOREDETERMINIZER CLASS ///////////////////////////////////////////////////
+
+OutOfCoreDeterminizer::OutOfCoreDeterminizer(const IndexedNFA& nfa, const std::string& directory):
+    nfa(nfa), directory(directory), slots(0), generation(0), count(0) {
+}
+OutOfCoreDeterminizer::~OutOfCoreDeterminizer() {
+}
+// read a subset back from the file
+void OutOfCoreDeterminizer::readSubset(uint64_t id, std::vector<uint32_t>& subset) const {
+    const uint64_t* starts = reinterpret_cast<const uint64_t*>(this->offsets.getData());
+    const uint32_t* states = reinterpret_cast<const uint32_t*>(this->subsets.getData());
+    subset.assign(states + starts[id], states + starts[id + 1]);
+}
+// double the hash table, moving the slots into a new file. the slots hold the hashes, so the
+// subsets themselves are not read
+bool OutOfCoreDeterminizer::growIndex() {
+    size_t newslots = this->slots == 0 ? initialslots : 2 * this->slots;
+    std::string path = this->directory + "/index" + std::to_string(this->generation++);
+    MappedFile grown;
+    if (!grown.create(path, newslots * 2 * sizeof(uint64_t))) {
+        return false;
+    }
+    uint64_t* from = reinterpret_cast<uint64_t*>(this->index.getData());
+    uint64_t* to = reinterpret_cast<uint64_t*>(grown.getData());
+    for (size_t slot = 0; slot < this->slots; slot++) {
+        if (from[2 * slot + 1] == 0) {
+            continue;
+        }
+        size_t position = from[2 * slot] & (newslots - 1);
+        while (to[2 * position + 1] != 0) {
+            position = (position + 1) & (newslots - 1);
+        }
+        to[2 * position] = from[2 * slot];
+        to[2 * position + 1] = from[2 * slot + 1];
+    }
+    // the new file takes the place of the old one, which is deleted with grown
+    this->index.swap(grown);
+    this->slots = newslots;
+    return true;
+}
+// the id of a subset, adding it when it is new. false when a file can't grow
+bool OutOfCoreDeterminizer::findSubset(const std::vector<uint32_t>& subset, uint32_t& id) {
+    if (2 * (this->count + 1) > this->slots and !this->growIndex()) {
+        return false;
+    }
+    uint64_t hash = hashSubset(subset);
+    uint64_t* table = reinterpret_cast<uint64_t*>(this->index.getData());
+    size_t position = hash & (this->slots - 1);
+    std::vector<uint32_t> candidate;
+    while (table[2 * position + 1] != 0) {
+        if (table[2 * position] == hash) {
+            this->readSubset(table[2 * position + 1] - 1, candidate);
+            if (candidate == subset) {
+                id = table[2 * position + 1] - 1;
+                return true;
+            }
+        }
+        position = (position + 1) & (this->slots - 1);
+    }
+    // append the subset, growing the files by doubling
+    uint64_t* starts = reinterpret_cast<uint64_t*>(this->offsets.getData());
+    uint64_t end = starts[this->count];
+    if ((end + subset.size()) * sizeof(uint32_t) > this->subsets.size() and
+        !this->subsets.resize(std::max(2 * this->subsets.size(), (end + subset.size()) * sizeof(uint32_t)))) {
+        return false;
+    }
+    if ((this->count + 2) * sizeof(uint64_t) > this->offsets.size()) {
+        if (!this->offsets.resize(2 * this->offsets.size())) {
+            return false;
+        }
+        starts = reinterpret_cast<uint64_t*>(this->offsets.getData());
+    }
+    if (!subset.empty()) {
+        memcpy(this->subsets.getData() + end * sizeof(uint32_t), subset.data(), subset.size() * sizeof(uint32_t));
+    }
+    starts[this->count + 1] = end + subset.size();
+    id = this->count++;
+    table[2 * position] = hash;
+    table[2 * position + 1] = id + 1;
+    return true;
+}
+// run the subset construction, writing the DFA to the given file. subsets get their ids in
+// the order they are found and are handled in that order, so the rows come out in order
+bool OutOfCoreDeterminizer::convert(const std::string& output) {
+    this->count = 0;
+    this->slots = 0;
+    if (!this->subsets.create(this->directory + "/subsets", 1 << 20) or
+        !this->offsets.create(this->directory + "/offsets", 1 << 20) or !this->growIndex()) {
+        return false;
+    }
+    uint32_t dead;
+    uint32_t start;
+    if (!this->findSubset(std::vector<uint32_t>(), dead) or !this->findSubset(this->nfa.getStartSet(), start)) {
+        return false;
+    }
+    FILE* file = fopen(output.c_str(), "wb");
+    if (file == NULL) {
+        std::cerr << "Couldn't create '" << output << "'." << std::endl;
+        return false;
+    }
+    std::vector<char> buffer(outputbuffersize);
+    setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    size_t classes = this->nfa.getClassCount();
+    uint64_t header[3] = {0, classes, start};
+    fwrite(compiledmagic, 1, 8, file);
+    fwrite(header, sizeof(uint64_t), 3, file);
+    for (int byte = 0; byte < 256; byte++) {
+        uint16_t symbolclass = this->nfa.getSymbolClass(byte);
+        fwrite(&symbolclass, sizeof(uint16_t), 1, file);
+    }
+    std::vector<uint32_t> current;
+    std::vector<uint32_t> target;
+    std::vector<uint32_t> row(classes, 0);
+    bool failed = false;
+    for (uint64_t id = 0; id < this->count and !failed; id++) {
+        this->readSubset(id, current);
+        char accept = this->nfa.accepts(current) ? 1 : 0;
+        for (size_t c = 0; c < classes and !failed; c++) {
+            row[c] = 0;
+            if (!current.empty() and c > 0) {
+                this->nfa.step(current, c, target);
+                failed = !this->findSubset(target, row[c]);
+            }
+        }
+        fwrite(&accept, 1, 1, file);
+        fwrite(row.data(), sizeof(uint32_t), classes, file);
+    }
+    header[0] = this->count;
+    fseek(file, 8, SEEK_SET);
+    fwrite(header, sizeof(uint64_t), 3, file);
+    failed = ferror(file) or failed;
+    fclose(file);
+    this->subsets.remove();
+    this->offsets.remove();
+    this->index.remove();
+    if (failed) {
+        std::cerr << "Writing the DFA to '" << output << "' failed." << std::endl;
+        return false;
+    }
+    return true;
+}
+// number of DFA states found
+size_t OutOfCoreDeterminizer::size() const {
+    return this->count;
+}
+
+// PARALLELDETERMINIZER CLASS ////////////////////////////////////////////////////
+
+typedef std::vector<std::pair<uint32_t, std::pair<const uint32_t*, uint32_t> > > FoundSubsets;
+
+// expands the subsets first up to first + the length of the range given to it: fills in
+// their rows and accept flags, collecting new subsets in the list of the worker
+struct ParallelDeterminizer::Expander {
+    ParallelDeterminizer* determinizer;
+    uint32_t first;
+    std::vector<int>* table;
+    std::vector<char>* accepting;
+    // two scratch subsets and the list of new subsets of every worker
+    std::vector<std::vector<uint32_t> >* targets;
+    std::vector<FoundSubsets>* found;
+    void operator()(size_t begin, size_t end, size_t worker) const {
+        const IndexedNFA& nfa = this->determinizer->nfa;
+        size_t classes = nfa.getClassCount();
+        std::vector<uint32_t>& target = (*this->targets)[2 * worker];
+        std::vector<uint32_t>& subset = (*this->targets)[2 * worker + 1];
+        for (size_t i = begin; i < end; i++) {
+            size_t id = this->first + i;
+            StoredSubset stored = this->determinizer->subsets[id];
+            subset.assign(stored.first, stored.first + stored.second);
+            (*this->accepting)[id] = nfa.accepts(subset);
+            // class 0 has no arrows, so it stays on the dead state
+            for (size_t c = 1; c < classes; c++) {
+                nfa.step(subset, c, target);
+                (*this->table)[id * classes + c] = this->determinizer->findSubset(target, (*this->found)[worker]);
+            }
+        }
+    }
+};
+
+ParallelDeterminizer::ParallelDeterminizer(const IndexedNFA& nfa, size_t threads):
+    nfa(nfa), threads(threads == 0 ? defaultThreadCount() : threads), shards(shardcount), count(0) {
+}
+// the id of a subset, adding it when it is new. the top bits of the hash pick the shard, so
+// threads only wait for each other when they look up subsets of the same shard
+uint32_t ParallelDeterminizer::findSubset(const std::vector<uint32_t>& subset, FoundSubsets& found) {
+    uint64_t hash = hashSubset(subset);
+    Shard& shard = this->shards[(hash >> 56) & (shardcount - 1)];
+    std::unique_lock<std::mutex> guard(shard.lock);
+    if (2 * (shard.used + 1) > shard.slots.size()) {
+        // double the table, the stored hashes tell where the slots go
+        std::vector<Slot> slots(shard.slots.empty() ? initialshardslots : 2 * shard.slots.size());
+        std::vector<Slot>::iterator slot;
+        for (slot = shard.slots.begin(); slot != shard.slots.end(); slot++) {
+            if (slot->id != 0) {
+                size_t position = slot->hash & (slots.size() - 1);
+                while (slots[position].id != 0) {
+                    position = (position + 1) & (slots.size() - 1);
+                }
+                slots[position] = *slot;
+            }
+        }
+        shard.slots.swap(slots);
+    }
+    size_t mask = shard.slots.size() - 1;
+    size_t position = hash & mask;
+    while (shard.slots[position].id != 0) {
+        const Slot& slot = shard.slots[position];
+        if (slot.hash == hash and slot.subset.second == subset.size() and
+            std::equal(subset.begin(), subset.end(), slot.subset.first)) {
+            return slot.id - 1;
+        }
+        position = (position + 1) & mask;
+    }
+    // append the subset to the last block, its states stay where they are as long as the
+    // block doesn't grow beyond what it reserved
+    if (shard.blocks.empty() or shard.blocks.back().size() + subset.size() > shard.blocks.back().capacity()) {
+        shard.blocks.push_back(std::vector<uint32_t>());
+        shard.blocks.back().reserve(std::max(blockstates, subset.size()));
+    }
+    std::vector<uint32_t>& block = shard.blocks.back();
+    block.insert(block.end(), subset.begin(), subset.end());
+    StoredSubset stored(block.data() + block.size() - subset.size(), subset.size());
+    uint32_t id = this->count++;
+    Slot& slot = shard.slots[position];
+    slot.hash = hash;
+    slot.subset = stored;
+    slot.id = id + 1;
+    shard.used++;
+    found.push_back(std::make_pair(id, stored));
+    return id;
+}
+// run the subset construction one breadth first level at a time, then number the states
+// again in breadth first order
+void ParallelDeterminizer::convert(CompiledDFA& result) {
+    size_t classes = this->nfa.getClassCount();
+    this->count = 0;
+    this->subsets.clear();
+    std::vector<FoundSubsets> found(this->threads);
+    this->findSubset(std::vector<uint32_t>(), found[0]);
+    uint32_t start = this->findSubset(this->nfa.getStartSet(), found[0]);
+    std::vector<int> table;
+    std::vector<char> accepting;
+    // two scratch subsets per worker
+    std::vector<std::vector<uint32_t> > targets(2 * this->threads);
+    // the dead state has no row to fill in
+    uint32_t begin = 1;
+    uint32_t end = 0;
+    do {
+        this->subsets.resize(this->count);
+        std::vector<FoundSubsets>::iterator list;
+        for (list = found.begin(); list != found.end(); list++) {
+            FoundSubsets::iterator subset;
+            for (subset = list->begin(); subset != list->end(); subset++) {
+                this->subsets[subset->first] = subset->second;
+            }
+            list->clear();
+        }
+        end = this->count;
+        table.resize(end * classes, 0);
+        accepting.resize(end, 0);
+        Expander expander = {this, begin, &table, &accepting, &targets, &found};
+        parallelFor(end - begin, this->threads, expander);
+        begin = end;
+    } while (begin < this->count);
+
+    // number the states in the order a breadth first search from the start state meets them
+    std::vector<int> number(end, -1);
+    std::vector<uint32_t> order(1, 0);
+    number[0] = 0;
+    if (start != 0) {
+        number[start] = 1;
+        order.push_back(start);
+    }
+    for (size_t i = 1; i < order.size(); i++) {
+        for (size_t c = 0; c < classes; c++) {
+            int target = table[order[i] * classes + c];
+            if (number[target] < 0) {
+                number[target] = order.size();
+                order.push_back(target);
+            }
+        }
+    }
+    std::vector<int> renumbered(order.size() * classes);
+    std::vector<bool> accepts(order.size());
+    for (size_t state = 0; state < order.size(); state++) {
+        accepts[state] = accepting[order[state]] != 0;
+        for (size_t c = 0; c < classes; c++) {
+            renumbered[state * classes + c] = number[table[order[state] * classes + c]];
+        }
+    }
+    std::vector<int> classof(256);
+    for (int byte = 0; byte < 256; byte++) {
+        classof[byte] = this->nfa.getSymbolClass(byte);
+    }
+    // the subsets are only needed while searching
+    this->subsets.clear();
+    std::vector<Shard>::iterator shard;
+    for (shard = this->shards.begin(); shard != this->shards.end(); shard++) {
+        shard->slots.clear();
+        shard->used = 0;
+        shard->blocks.clear();
+    }
+    result.setTable(classof, classes, renumbered, accepts, number[start]);
+}
+// number of DFA states found, including the dead state
+size_t ParallelDeterminizer::size() const {
+    return this->count;
+}
@@ -0,0 +1,153 @@
+/* Subset construction for NFAs with large DFAs.
+ * IndexedNFA numbers the states of an NFA or ENFA and stores its arrows per symbol class as
+ * integers, closed under epsilon. OutOfCoreDeterminizer runs the subset construction on it
+ * with every subset and the hash index that finds them in memory mapped files, so the
+ * kernel writes them back to disk and evicts them when memory runs short; the only memory
+ * it allocates itself is a few subsets. DFA states are numbered in the order they are found
+ * and handled in that order, so the rows of the DFA are written straight to the output file
+ * (in the format of CompiledDFA::save) and nothing recurses.
+ * ParallelDeterminizer builds the DFA in memory on several threads. It goes through the DFA
+ * breadth first, one level at a time: the subsets of a level are spread over the threads,
+ * which compute their successors for every symbol class and look them up in a hash map cut
+ * into shards with a lock each. Ids handed out that way depend on the timing of the threads,
+ * so the states are numbered again at the end in breadth first order from the start state,
+ * taking the classes in order. That numbering only depends on the DFA, so every run gives
+ * the same table.
+**/
+#ifndef SUBSET_H_
+#define SUBSET_H_
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+#include "automata.h"
+#include "matcher.h"
+
+// a file mapped into memory that can grow
+class MappedFile {
+    private:
+        MappedFile(const MappedFile&);
+        MappedFile operator=(const MappedFile&);
+        std::string path;
+        int descriptor;
+        char* data;
+        size_t length;
+        // map the current length of the file
+        bool map();
+    public:
+        MappedFile();
+        ~MappedFile();
+        // create the file (emptying an existing one) with the given size, false on failure
+        bool create(const std::string&, size_t);
+        // grow the file to the given size, keeping the contents
+        bool resize(size_t);
+        // unmap, close and delete the file
+        void remove();
+        // trade files with another object
+        void swap(MappedFile&);
+        char* getData() const;
+        size_t size() const;
+};
+
+// an NFA with numbered states and, per state and symbol class, the sorted epsilon closed
+// set of targets
+class IndexedNFA {
+    private:
+        std::vector<int> classOf;
+        size_t classes;
+        size_t states;
+        // targets of state q for class c: arrows[firstArrow[q * classes + c]] up to
+        // arrows[firstArrow[q * classes + c + 1]]
+        std::vector<size_t> firstArrow;
+        std::vector<uint32_t> arrows;
+        std::vector<uint32_t> startSet;
+        std::vector<bool> accepting;
+    public:
+        explicit IndexedNFA(const NFA&);
+        // the sorted set reached from a sorted set of states with a symbol class
+        void step(const std::vector<uint32_t>&, size_t, std::vector<uint32_t>&) const;
+        // whether a set of states contains an accept state
+        bool accepts(const std::vector<uint32_t>&) const;
+        // the closure of the start state
+        const std::vector<uint32_t>& getStartSet() const;
+        size_t getClassCount() const;
+        int getSymbolClass(unsigned char) const;
+        // number of states
+        size_t size() const;
+};
+
+class OutOfCoreDeterminizer {
+    private:
+        OutOfCoreDeterminizer(const OutOfCoreDeterminizer&);
+        OutOfCoreDeterminizer operator=(const OutOfCoreDeterminizer&);
+        const IndexedNFA& nfa;
+        std::string directory;
+        // every subset, one after the other, as 32 bit state numbers
+        MappedFile subsets;
+        // where every subset starts in subsets, plus where the next one will start
+        MappedFile offsets;
+        // open addressing hash table of 16 byte slots: the hash of a subset and its id plus one
+        MappedFile index;
+        size_t slots;
+        size_t generation;
+        uint64_t count;
+        // the id of a subset, adding it when it is new. false when a file can't grow
+        bool findSubset(const std::vector<uint32_t>&, uint32_t&);
+        // double the hash table
+        bool growIndex();
+        // read a subset back from the file
+        void readSubset(uint64_t, std::vector<uint32_t>&) const;
+    public:
+        // the working files go into the given directory and are deleted afterwards
+        OutOfCoreDeterminizer(const IndexedNFA&, const std::string&);
+        ~OutOfCoreDeterminizer();
+        // run the subset construction, writing the DFA to the given file. the empty subset is
+        // state 0, so it is the dead state. returns false on a failing file
+        bool convert(const std::string&);
+        // number of DFA states found
+        size_t size() const;
+};
+
+class ParallelDeterminizer {
+    private:
+        ParallelDeterminizer(const ParallelDeterminizer&);
+        ParallelDeterminizer operator=(const ParallelDeterminizer&);
+        // where a subset is kept: its states and how many there are
+        typedef std::pair<const uint32_t*, uint32_t> StoredSubset;
+        struct Slot {
+            uint64_t hash;
+            StoredSubset subset;
+            // id plus one, 0 for an empty slot
+            uint32_t id;
+        };
+        // a part of the subset map: an open addressing table over subsets that are stored in
+        // blocks, which never move once they are allocated
+        struct Shard {
+            std::mutex lock;
+            std::vector<Slot> slots;
+            size_t used;
+            std::vector<std::vector<uint32_t> > blocks;
+            Shard(): used(0) {}
+        };
+        // expands the subsets of one level, run by parallelFor
+        struct Expander;
+        const IndexedNFA& nfa;
+        size_t threads;
+        std::vector<Shard> shards;
+        std::atomic<uint32_t> count;
+        // the subset of every id, pointing into the shards
+        std::vector<StoredSubset> subsets;
+        // the id of a subset, adding it when it is new. new subsets are added to the list
+        uint32_t findSubset(const std::vector<uint32_t>&, std::vector<std::pair<uint32_t, StoredSubset> >&);
+    public:
+        // 0 threads means one per core
+        ParallelDeterminizer(const IndexedNFA&, size_t = 0);
+        // run the subset construction. the empty subset becomes the dead state 0
+        void convert(CompiledDFA&);
+        // number of DFA states found, including the dead state
+        size_t size() const;
+};
+
+#endif
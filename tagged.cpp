@@ -0,0 +1,360 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include "tagged.h"
+
+// the NFA states of a list of items
+static std::vector<int> itemStates(const std::vector<std::pair<int, std::vector<int> > >& items) {
+    std::vector<int> states;
+    for (size_t i = 0; i < items.size(); i++) {
+        states.push_back(items[i].first);
+    }
+    return states;
+}
+
+// TAGGEDNFA CLASS ///////////////////////////////////////////////////////////////
+
+TaggedNFA::TaggedNFA(): start(0), accept(1), groups(0) {
+    this->addState();
+    this->addState();
+}
+TaggedNFA::TaggedNFA(const RegexTree& tree): start(0), accept(1), groups(0) {
+    this->compile(tree);
+}
+int TaggedNFA::addState() {
+    this->arrows.push_back(std::vector<Arrow>());
+    return this->arrows.size() - 1;
+}
+void TaggedNFA::addArrow(int from, int to, int symbol, int tag) {
+    Arrow arrow = {to, symbol, tag};
+    this->arrows[from].push_back(arrow);
+}
+// the Thompson fragment of a subtree, with the epsilon arrows of every state in order of
+// priority. the exit state has no arrows yet
+std::pair<int, int> TaggedNFA::build(const RegexTree& tree, int node) {
+    const RegexNode& n = tree.nodes[node];
+    std::pair<int, int> left;
+    std::pair<int, int> right;
+    if (n.kind == REGEX_UNION or n.kind == REGEX_CONCAT) {
+        left = this->build(tree, n.left);
+        right = this->build(tree, n.right);
+        if (n.kind == REGEX_CONCAT) {
+            this->addArrow(left.second, right.first, -1, -1);
+            return std::make_pair(left.first, right.second);
+        }
+    }
+    else if (n.kind == REGEX_STAR or n.kind == REGEX_GROUP) {
+        left = this->build(tree, n.left);
+    }
+    int entry = this->addState();
+    int exit = this->addState();
+    switch (n.kind) {
+        case REGEX_EMPTY:
+        case REGEX_CONCAT:
+            break;
+        case REGEX_EPSILON:
+            this->addArrow(entry, exit, -1, -1);
+            break;
+        case REGEX_SYMBOL:
+            this->addArrow(entry, exit, static_cast<unsigned char>(n.symbol), -1);
+            break;
+        case REGEX_UNION:
+            // the left side goes first
+            this->addArrow(entry, left.first, -1, -1);
+            this->addArrow(entry, right.first, -1, -1);
+            this->addArrow(left.second, exit, -1, -1);
+            this->addArrow(right.second, exit, -1, -1);
+            break;
+        case REGEX_STAR:
+            // another round goes before leaving
+            this->addArrow(entry, left.first, -1, -1);
+            this->addArrow(entry, exit, -1, -1);
+            this->addArrow(left.second, entry, -1, -1);
+            break;
+        case REGEX_GROUP:
+            this->addArrow(entry, left.first, -1, 2 * (n.right - 1));
+            this->addArrow(left.second, exit, -1, 2 * (n.right - 1) + 1);
+            break;
+    }
+    return std::make_pair(entry, exit);
+}
+// build the automaton of a tree parsed with capture groups
+void TaggedNFA::compile(const RegexTree& tree) {
+    this->arrows.clear();
+    this->groups = tree.getGroupCount();
+    std::pair<int, int> fragment = this->build(tree, tree.root);
+    this->start = fragment.first;
+    this->accept = fragment.second;
+}
+// number of capture groups
+int TaggedNFA::getGroupCount() const {
+    return this->groups;
+}
+// number of states
+size_t TaggedNFA::size() const {
+    return this->arrows.size();
+}
+
+// TAGGEDDFA CLASS ///////////////////////////////////////////////////////////////
+
+TaggedDFA::TaggedDFA(): classOf(256, 0), classes(1), table(1, 0), firstOperation(2, 0), accepting(1, false),
+    start(0), tags(0), registers(1), longestOperations(0) {
+}
+TaggedDFA::TaggedDFA(const TaggedNFA& nfa): classOf(256, 0), classes(1), table(1, 0), firstOperation(2, 0),
+    accepting(1, false), start(0), tags(0), registers(1), longestOperations(0) {
+    this->determinize(nfa);
+}
+// parse a regex with capture groups and build its tagged DFA, false on a syntax error
+bool TaggedDFA::compile(const std::string& regex) {
+    RegexTree tree;
+    bool parsed = tree.parse(regex, true);
+    this->determinize(TaggedNFA(tree));
+    return parsed;
+}
+// the items reached from the given ones through epsilon arrows, in the order of a depth first
+// search that takes the arrows in order of priority: a state keeps the first path that gets
+// there. only the accept state and states with a byte arrow are kept
+void TaggedDFA::closure(const TaggedNFA& nfa, const std::vector<Item>& seeds, std::vector<Item>& result) const {
+    result.clear();
+    std::vector<bool> visited(nfa.size(), false);
+    std::vector<Item> stack;
+    std::vector<Item>::const_iterator seed;
+    for (seed = seeds.begin(); seed != seeds.end(); seed++) {
+        stack.push_back(*seed);
+        while (!stack.empty()) {
+            Item item = stack.back();
+            stack.pop_back();
+            if (visited[item.first]) {
+                continue;
+            }
+            visited[item.first] = true;
+            const std::vector<TaggedNFA::Arrow>& arrows = nfa.arrows[item.first];
+            bool kept = item.first == nfa.accept;
+            // pushed in reverse, so the first arrow is followed first
+            for (size_t i = arrows.size(); i-- > 0;) {
+                if (arrows[i].symbol >= 0) {
+                    kept = true;
+                    continue;
+                }
+                stack.push_back(item);
+                if (arrows[i].tag >= 0) {
+                    stack.back().second[arrows[i].tag] = -2;
+                }
+                stack.back().first = arrows[i].target;
+            }
+            if (kept) {
+                result.push_back(item);
+            }
+        }
+    }
+}
+// build the tagged DFA. register 0 always holds -1 for tags that were never passed; a tag
+// passed while reading a byte gets a fresh register set to the offset after it. a new state
+// that differs from a known one only in its registers becomes that state, with copies from
+// its registers to the registers of the known one
+void TaggedDFA::determinize(const TaggedNFA& nfa) {
+    this->tags = 2 * nfa.getGroupCount();
+    this->registers = 1;
+    this->classOf.assign(256, 0);
+    this->classes = 1;
+    for (size_t state = 0; state < nfa.size(); state++) {
+        std::vector<TaggedNFA::Arrow>::const_iterator arrow;
+        for (arrow = nfa.arrows[state].begin(); arrow != nfa.arrows[state].end(); arrow++) {
+            if (arrow->symbol >= 0 and this->classOf[arrow->symbol] == 0) {
+                this->classOf[arrow->symbol] = this->classes++;
+            }
+        }
+    }
+    // state 0 is the dead state, its kernel is empty
+    std::vector<std::vector<Item> > kernels(1);
+    std::map<std::vector<int>, std::vector<int> > byStates;
+    std::vector<Item> seeds(1, Item(nfa.start, std::vector<int>(this->tags, 0)));
+    std::vector<Item> kernel;
+    this->closure(nfa, seeds, kernel);
+    this->initial.clear();
+    this->start = 0;
+    if (!kernel.empty()) {
+        for (int tag = 0; tag < this->tags; tag++) {
+            int fresh = -1;
+            for (size_t i = 0; i < kernel.size(); i++) {
+                if (kernel[i].second[tag] == -2) {
+                    if (fresh < 0) {
+                        fresh = this->registers++;
+                        Operation operation = {fresh, -1};
+                        this->initial.push_back(operation);
+                    }
+                    kernel[i].second[tag] = fresh;
+                }
+            }
+        }
+        kernels.push_back(kernel);
+        byStates[itemStates(kernel)].push_back(1);
+        this->start = 1;
+    }
+    this->table.clear();
+    this->firstOperation.clear();
+    this->operations.clear();
+    this->accepting.clear();
+    this->finalRegisters.clear();
+    this->longestOperations = this->initial.size();
+    for (size_t state = 0; state < kernels.size(); state++) {
+        // kernels grows in the loop, so keep a copy
+        std::vector<Item> current = kernels[state];
+        for (size_t c = 0; c < this->classes; c++) {
+            this->table.push_back(0);
+            this->firstOperation.push_back(this->operations.size());
+            seeds.clear();
+            for (size_t i = 0; i < current.size() and c > 0; i++) {
+                std::vector<TaggedNFA::Arrow>::const_iterator arrow;
+                const std::vector<TaggedNFA::Arrow>& arrows = nfa.arrows[current[i].first];
+                for (arrow = arrows.begin(); arrow != arrows.end(); arrow++) {
+                    if (arrow->symbol >= 0 and this->classOf[arrow->symbol] == static_cast<int>(c)) {
+                        seeds.push_back(Item(arrow->target, current[i].second));
+                    }
+                }
+            }
+            this->closure(nfa, seeds, kernel);
+            if (kernel.empty()) {
+                continue;
+            }
+            // one fresh register per tag passed on this arrow, they all hold the same offset
+            int firstfresh = this->registers;
+            std::vector<int> fresh(this->tags, -1);
+            for (size_t i = 0; i < kernel.size(); i++) {
+                for (int tag = 0; tag < this->tags; tag++) {
+                    if (kernel[i].second[tag] == -2) {
+                        if (fresh[tag] < 0) {
+                            fresh[tag] = this->registers++;
+                        }
+                        kernel[i].second[tag] = fresh[tag];
+                    }
+                }
+            }
+            // look for a known state with the same NFA states whose registers correspond one
+            // to one with these
+            std::vector<int>& candidates = byStates[itemStates(kernel)];
+            int target = -1;
+            std::map<int, int> forward;
+            for (size_t k = 0; k < candidates.size() and target < 0; k++) {
+                const std::vector<Item>& known = kernels[candidates[k]];
+                std::map<int, int> backward;
+                forward.clear();
+                bool matches = true;
+                for (size_t i = 0; i < kernel.size() and matches; i++) {
+                    for (int tag = 0; tag < this->tags and matches; tag++) {
+                        int from = kernel[i].second[tag];
+                        int to = known[i].second[tag];
+                        if (from == 0 or to == 0) {
+                            matches = from == to;
+                            continue;
+                        }
+                        std::map<int, int>::iterator f = forward.insert(std::make_pair(from, to)).first;
+                        std::map<int, int>::iterator b = backward.insert(std::make_pair(to, from)).first;
+                        matches = f->second == to and b->second == from;
+                    }
+                }
+                if (matches) {
+                    target = candidates[k];
+                }
+            }
+            if (target >= 0) {
+                // the fresh registers are not needed, their offset goes straight to the
+                // registers of the known state
+                this->registers = firstfresh;
+                std::map<int, int>::iterator pair;
+                for (pair = forward.begin(); pair != forward.end(); pair++) {
+                    if (pair->first != pair->second) {
+                        Operation operation = {pair->second, pair->first >= firstfresh ? -1 : pair->first};
+                        this->operations.push_back(operation);
+                    }
+                }
+            }
+            else {
+                for (int tag = 0; tag < this->tags; tag++) {
+                    if (fresh[tag] >= 0) {
+                        Operation operation = {fresh[tag], -1};
+                        this->operations.push_back(operation);
+                    }
+                }
+                target = kernels.size();
+                candidates.push_back(target);
+                kernels.push_back(kernel);
+            }
+            this->table.back() = target;
+            this->longestOperations = std::max(this->longestOperations, this->operations.size() - this->firstOperation.back());
+        }
+        // the first accept item has the best path
+        this->accepting.push_back(false);
+        for (size_t i = 0; i < current.size(); i++) {
+            if (current[i].first == nfa.accept) {
+                this->accepting.back() = true;
+                this->finalRegisters.insert(this->finalRegisters.end(), current[i].second.begin(), current[i].second.end());
+                break;
+            }
+        }
+        if (!this->accepting.back()) {
+            this->finalRegisters.insert(this->finalRegisters.end(), this->tags, 0);
+        }
+    }
+    this->firstOperation.push_back(this->operations.size());
+}
+// run a list of operations: every operation reads before any of them writes
+void TaggedDFA::apply(const Operation* list, size_t count, long offset, TagScratch& scratch) const {
+    for (size_t i = 0; i < count; i++) {
+        scratch.values[i] = list[i].source < 0 ? offset : scratch.registers[list[i].source];
+    }
+    for (size_t i = 0; i < count; i++) {
+        scratch.registers[list[i].target] = scratch.values[i];
+    }
+}
+// whether the whole text matches, with the offsets of the groups when it does
+bool TaggedDFA::match(const char* text, size_t length, std::vector<Capture>& captures, TagScratch& scratch) const {
+    scratch.registers.assign(this->registers, -1);
+    if (scratch.values.size() < this->longestOperations) {
+        scratch.values.resize(this->longestOperations);
+    }
+    this->apply(this->initial.data(), this->initial.size(), 0, scratch);
+    int state = this->start;
+    for (size_t i = 0; i < length; i++) {
+        size_t arrow = state * this->classes + this->classOf[static_cast<unsigned char>(text[i])];
+        state = this->table[arrow];
+        if (state == 0) {
+            return false;
+        }
+        size_t first = this->firstOperation[arrow];
+        if (first != this->firstOperation[arrow + 1]) {
+            this->apply(&this->operations[first], this->firstOperation[arrow + 1] - first, i + 1, scratch);
+        }
+    }
+    if (!this->accepting[state]) {
+        return false;
+    }
+    captures.assign(this->tags / 2 + 1, Capture(-1, -1));
+    captures[0] = Capture(0, length);
+    size_t final = state * this->tags;
+    for (int group = 0; group < this->tags / 2; group++) {
+        long open = scratch.registers[this->finalRegisters[final + 2 * group]];
+        long close = scratch.registers[this->finalRegisters[final + 2 * group + 1]];
+        if (open >= 0 and close >= 0) {
+            captures[group + 1] = Capture(open, close);
+        }
+    }
+    return true;
+}
+bool TaggedDFA::match(const std::string& text, std::vector<Capture>& captures) const {
+    TagScratch scratch;
+    return this->match(text.data(), text.size(), captures, scratch);
+}
+// number of states, including the dead state
+size_t TaggedDFA::size() const {
+    return this->accepting.size();
+}
+// number of capture groups
+int TaggedDFA::getGroupCount() const {
+    return this->tags / 2;
+}
+// number of registers, including register 0
+int TaggedDFA::getRegisterCount() const {
+    return this->registers;
+}
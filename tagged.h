@@ -0,0 +1,107 @@
+/* Submatch extraction with tagged automata.
+ * A capture group {r} of a regex (see regexengine.h) becomes two tags, one where the group
+ * opens and one where it closes. TaggedNFA is the Thompson automaton of the regex with the
+ * tags on epsilon arrows, and with the epsilon arrows of every state in order of priority:
+ * the left side of a union comes first and a star prefers another round over leaving, so the
+ * first path found is the leftmost greedy one (the one a backtracking matcher would take).
+ * TaggedDFA determinizes it with registers (Laurikari's TDFA): a DFA state is the ordered
+ * list of the NFA states it stands for, each with the register that holds every tag on its
+ * best path. Transitions carry the register operations that keep those registers up to
+ * date, so a match is one pass over the text with a table lookup per byte and an operation
+ * list on some arrows: no backtracking, and no allocation once the scratch space is there.
+**/
+#ifndef TAGGED_H_
+#define TAGGED_H_
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "regexengine.h"
+
+// start and end offset of a capture group, the end is one past the last byte. both are -1
+// when the group took no part in the match
+typedef std::pair<long, long> Capture;
+
+class TaggedNFA {
+    private:
+        // an arrow on a byte, or an epsilon arrow (symbol -1) that may set a tag (-1 for none)
+        struct Arrow {
+            int target;
+            int symbol;
+            int tag;
+        };
+        // the arrows of every state, in order of priority
+        std::vector<std::vector<Arrow> > arrows;
+        int start;
+        int accept;
+        int groups;
+        int addState();
+        void addArrow(int, int, int, int);
+        // the Thompson fragment of a subtree, returns its entry and exit state
+        std::pair<int, int> build(const RegexTree&, int);
+        friend class TaggedDFA;
+    public:
+        TaggedNFA();
+        explicit TaggedNFA(const RegexTree&);
+        // build the automaton of a tree parsed with capture groups
+        void compile(const RegexTree&);
+        // number of capture groups, tags 2i and 2i + 1 open and close group i + 1
+        int getGroupCount() const;
+        // number of states
+        size_t size() const;
+};
+
+// registers and operation values of a running match, kept between matches
+struct TagScratch {
+    std::vector<long> registers;
+    std::vector<long> values;
+};
+
+class TaggedDFA {
+    private:
+        // a register operation: set target to the current offset (source -1) or copy source.
+        // the operations of one arrow all read before any of them writes
+        struct Operation {
+            int target;
+            int source;
+        };
+        // an NFA state together with the register of every tag
+        typedef std::pair<int, std::vector<int> > Item;
+        std::vector<int> classOf;
+        size_t classes;
+        // successor of every state for every class, state 0 is the dead state
+        std::vector<int> table;
+        // the operations of arrow i are operations[firstOperation[i]] up to
+        // operations[firstOperation[i + 1]]
+        std::vector<size_t> firstOperation;
+        std::vector<Operation> operations;
+        // operations before the first byte
+        std::vector<Operation> initial;
+        std::vector<bool> accepting;
+        // the registers holding the tags of a match ending in every state
+        std::vector<int> finalRegisters;
+        int start;
+        int tags;
+        int registers;
+        size_t longestOperations;
+        // the items reached from the given ones through epsilon arrows, best path first. tags
+        // passed on the way get register -2, to be replaced by a fresh register
+        void closure(const TaggedNFA&, const std::vector<Item>&, std::vector<Item>&) const;
+        void apply(const Operation*, size_t, long, TagScratch&) const;
+    public:
+        TaggedDFA();
+        explicit TaggedDFA(const TaggedNFA&);
+        // parse a regex with capture groups and build its tagged DFA, false on a syntax error
+        bool compile(const std::string&);
+        void determinize(const TaggedNFA&);
+        // whether the whole text matches. when it does, captures gets the whole match at index
+        // 0 and the groups from index 1
+        bool match(const char*, size_t, std::vector<Capture>&, TagScratch&) const;
+        bool match(const std::string&, std::vector<Capture>&) const;
+        // number of states, including the dead state
+        size_t size() const;
+        int getGroupCount() const;
+        int getRegisterCount() const;
+};
+
+#endif